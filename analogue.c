@@ -65,7 +65,6 @@ void initAnalogue(unsigned char port) {
 
 
 void pollAnalogue(unsigned char port) {
-    unsigned char io;
     unsigned char adc;
 
     // is conversion finished?
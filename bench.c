@@ -0,0 +1,292 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   bench.c
+ * Author: Ian
+ * 
+ * Instruction cycle counts of the hot paths. Only built when BENCHMARK is 
+ * defined, when runBenchmarks() is called once the module is initialised.
+ *
+ * TMR1 is switched to count instruction cycles (Fosc/4, 1:1) and each routine
+ * is called with fixed inputs, once to warm up and then BENCH_RUNS times with
+ * the average number of cycles per call, less the cost of starting and 
+ * stopping the count, left in benchCycles[]. Interrupts are off throughout so 
+ * nothing else is counted. The CAN routines are run with the ECAN in 
+ * configuration or loopback mode so nothing reaches the bus. Afterwards TMR1,
+ * the ECAN, the CAN driver's fifos and the section ownership are put back and
+ * benchDone() is called, which is where a simulator or debugger stops to read
+ * the results.
+ *
+ * The counts are the same on the module as under an instruction level
+ * simulator where it models the peripherals used. For receivedControlMessage()
+ * the message is for the highest numbered section with a node number set so 
+ * the section lookup is the longest the NVs allow, and the section is made 
+ * uncontrolled before each run so that every run takes it from there. With
+ * NV_FLAG_TAKE_SEQUENCE set and an EN up to 15 only the lookup is counted.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "GenericTypeDefs.h"
+#include "hwsettings.h"
+#include "module.h"
+#include "cbus.h"
+#include "can18.h"
+#include "cabdccan18.h"
+#include "cabdcNv.h"
+#include "sections.h"
+#include "ownership.h"
+#include "switches.h"
+#include "leds.h"
+#include "bench.h"
+
+#ifdef BENCHMARK
+
+extern char speed(unsigned char reading);
+extern void canFillRxFifo(void);
+extern BYTE txIndexNextFree;
+extern BYTE txIndexNextUsed;
+extern BYTE rxIndexNextFree;
+extern BYTE rxIndexNextUsed;
+extern BOOL canTransmitFailed;
+
+#define BENCH_CANID         0x7E    // sender of the frames looped back to the receive FIFO
+#define BENCH_MODE_TIMEOUT  10000   // loops to wait for an ECAN mode change or transmission
+
+#define CAN_MODE_NORMAL     0b00000000
+#define CAN_MODE_LOOPBACK   0b01000000
+#define CAN_MODE_CONFIG     0b10000000
+
+WORD benchCycles[BENCH_COUNT];
+
+static WORD benchOverhead;
+static DWORD benchTotal;
+
+// TMR1 is read low byte first, which latches the high byte
+#define BENCH_START()       { TMR1H = 0; TMR1L = 0; }
+#define BENCH_STOP()        { count.v[0] = TMR1L; count.v[1] = TMR1H; benchTotal += count.Val; }
+
+static WORD_VAL count;
+
+static void benchRecord(BYTE bench) {
+    WORD cycles;
+
+    cycles = (WORD)(benchTotal / BENCH_RUNS);
+    benchCycles[bench] = (cycles > benchOverhead) ? cycles - benchOverhead : 0;
+    if (PIR1bits.TMR1IF) {
+        benchCycles[bench] = 0xFFFF;    // a call took more than 65535 cycles
+        PIR1bits.TMR1IF = 0;
+    }
+    benchTotal = 0;
+}
+
+static void benchCanMode(BYTE mode) {
+    WORD timeout = BENCH_MODE_TIMEOUT;
+
+    CANCON = mode;
+    while (((CANSTAT & 0xE0) != mode) && --timeout);
+}
+
+// Put frames in the ECAN receive FIFO by looping them back from TXB0
+static void benchLoadRxFifo(void) {
+    BYTE f;
+    WORD timeout;
+
+    for (f=0; f<BENCH_RX_FRAMES; f++) {
+        TXB0SIDH = 0b10110000 | ((BENCH_CANID & 0x78) >> 3);
+        TXB0SIDL = (BENCH_CANID & 0x07) << 5;
+        TXB0DLC = 5;
+        TXB0D0 = OPC_ASON3;
+        TXB0D1 = 0;
+        TXB0D2 = 0;
+        TXB0D3 = 0;
+        TXB0D4 = f;
+        TXB0CONbits.TXREQ = 1;
+        timeout = BENCH_MODE_TIMEOUT;
+        while (TXB0CONbits.TXREQ && --timeout);
+    }
+}
+
+static void benchCan(void) {
+    CanPacket packet;
+    BYTE i;
+    BYTE savedProbeState;
+    BYTE savedSidh;
+    BYTE savedSidl;
+
+    savedProbeState = canIdProbeState;
+    canIdProbeState = CANID_PROBE_IDLE;     // so canTX() may send
+    packet.buffer[dlc] = 5;
+    packet.buffer[d0] = OPC_ACON3;
+    packet.buffer[d1] = 0;
+    packet.buffer[d2] = 1;
+    packet.buffer[d3] = 0;
+    packet.buffer[d4] = 1;
+
+    // the frames stay in TXB0 in configuration mode
+    benchCanMode(CAN_MODE_CONFIG);
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        TXB0CONbits.TXREQ = 0;
+        canTransmitFailed = FALSE;
+        txIndexNextFree = txIndexNextUsed;
+        BENCH_START();
+        canTX(&packet);
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_CAN_TX);
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        TXB0CONbits.TXREQ = 1;
+        txIndexNextFree = txIndexNextUsed;
+        BENCH_START();
+        canTX(&packet);
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_CAN_TX_QUEUED);
+    TXB0CONbits.TXREQ = 0;
+    txIndexNextFree = txIndexNextUsed;
+
+    savedSidh = TXB0SIDH;
+    savedSidl = TXB0SIDL;
+    benchCanMode(CAN_MODE_LOOPBACK);
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        benchLoadRxFifo();
+        BENCH_START();
+        canFillRxFifo();
+        BENCH_STOP();
+        rxIndexNextUsed = rxIndexNextFree;
+    }
+    benchRecord(BENCH_CAN_FILL_RX_FIFO);
+    TXB0SIDH = savedSidh;
+    TXB0SIDL = savedSidl;
+    benchCanMode(CAN_MODE_NORMAL);
+    canIdProbeState = savedProbeState;
+}
+
+static void benchReceivedControl(void) {
+    BYTE msg[d7+1];
+    BYTE section;
+    BYTE last;
+    BYTE i;
+    SectionMask savedOurs;
+    SectionMask savedOthers;
+
+    // the last section with a node number
+    msg[d5] = 0;
+    msg[d6] = 0;
+    msg[d7] = 0;
+    last = 0;
+    for (section=0; section<NUM_SECTIONS; section++) {
+        if ((NV->sections[section].section_nn_bytes.section_nn_h != 0) 
+                || (NV->sections[section].section_nn_bytes.section_nn_l != 0)) {
+            msg[d5] = NV->sections[section].section_nn_bytes.section_nn_h;
+            msg[d6] = NV->sections[section].section_nn_bytes.section_nn_l;
+            msg[d7] = NV->sections[section].section_en_bytes.section_en_l;
+            last = section;
+        }
+    }
+    msg[d0] = OPC_ASON3;
+    msg[d1] = 0;
+    msg[d2] = 0;
+    msg[d3] = 0;
+    msg[d4] = 1;
+    savedOurs = ourControlled;
+    savedOthers = otherControlled;
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        // otherwise the later runs would only see a heartbeat
+        ourControlled = savedOurs & ~SECTION_BIT(last);
+        otherControlled = savedOthers & ~SECTION_BIT(last);
+        BENCH_START();
+        receivedControlMessage(msg);
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_RECEIVED_CONTROL);
+    ourControlled = savedOurs;
+    otherControlled = savedOthers;
+    // drop the lease and the change waiting to be written to EEPROM
+    initOwnership();
+}
+
+void runBenchmarks(void) {
+    BYTE savedT1con;
+    BYTE i;
+
+    di();
+    savedT1con = T1CON;
+    T1CON = 0b00000011;             // Fosc/4, 1:1, 16 bit read/write, on
+    PIR1bits.TMR1IF = 0;
+
+    // the cost of the measurement itself
+    benchOverhead = 0;
+    for (i=0; i<BENCH_RUNS; i++) {
+        BENCH_START();
+        BENCH_STOP();
+    }
+    benchOverhead = (WORD)(benchTotal / BENCH_RUNS);
+    benchTotal = 0;
+
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        BENCH_START();
+        pollLeds();
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_POLL_LEDS);
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        BENCH_START();
+        pollSwitches(TRUE);
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_POLL_SWITCHES);
+    for (i=0; i<=BENCH_RUNS; i++) {
+        if (i == 1) benchTotal = 0;
+        BENCH_START();
+        speed(200);
+        BENCH_STOP();
+    }
+    benchRecord(BENCH_SPEED);
+    benchCan();
+    benchReceivedControl();
+
+    TMR1H = 0;
+    TMR1L = 0;
+    T1CON = savedT1con;
+    PIR1bits.TMR1IF = 0;
+    ei();
+    benchDone();
+}
+
+/**
+ * Nothing to do. The benchmarks have finished and the results are in 
+ * benchCycles[]. A simulator stops here.
+ */
+void benchDone(void) {
+    Nop();
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   bench.h
+ * Author: Ian
+ *
+ * Cycle counts of the routines on the busiest paths, taken when the firmware
+ * is built with BENCHMARK defined. See bench.c and bench/gpsim-bench.sh.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef BENCH_H
+#define	BENCH_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+#ifdef BENCHMARK
+
+/*
+ * The routines measured, the index into benchCycles[]. bench/gpsim-bench.sh
+ * names them in this order.
+ */
+#define BENCH_POLL_LEDS             0
+#define BENCH_POLL_SWITCHES         1
+#define BENCH_SPEED                 2
+#define BENCH_CAN_TX                3   // transmit buffer free
+#define BENCH_CAN_TX_QUEUED         4   // transmit buffer busy so into the software fifo
+#define BENCH_CAN_FILL_RX_FIFO      5   // BENCH_RX_FRAMES frames in the ECAN FIFO
+#define BENCH_RECEIVED_CONTROL      6
+#define BENCH_COUNT                 7
+
+#define BENCH_RUNS                  8   // calls averaged for each routine, after one to warm up
+#define BENCH_RX_FRAMES             4
+
+extern WORD benchCycles[BENCH_COUNT];  // instruction cycles per call, 0xFFFF if too long to measure
+
+extern void runBenchmarks(void);
+extern void benchDone(void);
+
+#endif
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* BENCH_H */
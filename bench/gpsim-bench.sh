@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# Cycle counts of the firmware's hot paths under gpsim, compared against the
+# stored baselines. See "Benchmarks" in the README.
+#
+# usage: gpsim-bench.sh [-u] [-p processor] firmware.cod firmware.map
+#   firmware.cod  the firmware built with BENCHMARK defined
+#   firmware.map  the linker map of that build, for the address of benchCycles
+#   -u            store the counts as the new baselines
+#   -p            gpsim processor to run as, if not the one in firmware.cod
+#
+# The exit status is 1 if any routine takes more than TOLERANCE percent (5 by
+# default) more cycles than its baseline.
+
+# in the order of the BENCH_ indexes in bench.h
+NAMES="pollLeds pollSwitches speed canTX canTX_queued canFillRxFifo receivedControlMessage"
+
+HERE=$(dirname "$0")
+BASELINE=${BASELINE:-$HERE/baseline.txt}
+TOLERANCE=${TOLERANCE:-5}
+UPDATE=
+PROCESSOR=
+
+while getopts up: opt; do
+    case $opt in
+        u) UPDATE=1 ;;
+        p) PROCESSOR=$OPTARG ;;
+        *) sed -n '4,12p' "$0" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 2 ]; then
+    sed -n '4,12p' "$0" >&2
+    exit 2
+fi
+COD=$1
+MAP=$2
+
+# MPLINK lists the symbols as: name address location storage file
+ADDR=$(awk '$1 == "benchCycles" && $3 == "data" { print $2; exit }' "$MAP")
+if [ -z "$ADDR" ]; then
+    echo "benchCycles is not in $MAP, was the firmware built with BENCHMARK defined?" >&2
+    exit 2
+fi
+
+CMDS=$(mktemp)
+OUT=$(mktemp)
+trap 'rm -f "$CMDS" "$OUT"' EXIT
+{
+    [ -n "$PROCESSOR" ] && echo "processor $PROCESSOR"
+    echo "load s $COD"
+    echo "break e benchDone"
+    echo "run"
+    i=0
+    for name in $NAMES; do
+        printf 'x 0x%x\nx 0x%x\n' $((ADDR + 2*i)) $((ADDR + 2*i + 1))
+        i=$((i + 1))
+    done
+    echo "quit"
+} > "$CMDS"
+gpsim -i -c "$CMDS" > "$OUT" 2>&1
+
+# each x prints the register with its value last on the line
+set -- $(grep -E '^[[:space:]]*0x[0-9a-fA-F]+.*=' "$OUT" | awk '{ print $NF }')
+if [ $# -ne $((2 * $(echo $NAMES | wc -w))) ]; then
+    echo "gpsim did not stop at benchDone or report benchCycles:" >&2
+    cat "$OUT" >&2
+    exit 2
+fi
+
+status=0
+[ -n "$UPDATE" ] && {
+    echo "# cycles per call, written by gpsim-bench.sh -u on $(date +%Y-%m-%d)"
+    echo "# gpsim $(gpsim -v 2>&1 | head -1)"
+} > "$BASELINE.new"
+printf '%-24s %8s %8s\n' routine cycles baseline
+for name in $NAMES; do
+    cycles=$(( ($2 << 8) + $1 ))
+    shift 2
+    base=$(awk -v n="$name" '$1 == n { print $2 }' "$BASELINE" 2>/dev/null)
+    note=
+    if [ "$cycles" -eq 65535 ]; then
+        note="too long to measure"
+    elif [ -n "$base" ] && [ $((cycles * 100)) -gt $((base * (100 + TOLERANCE))) ]; then
+        note="REGRESSION"
+        status=1
+    fi
+    printf '%-24s %8u %8s %s\n' "$name" "$cycles" "${base:--}" "$note"
+    [ -n "$UPDATE" ] && echo "$name $cycles" >> "$BASELINE.new"
+done
+if [ -n "$UPDATE" ]; then
+    mv "$BASELINE.new" "$BASELINE"
+    echo "baselines stored in $BASELINE"
+    status=0
+fi
+exit $status
@@ -0,0 +1,69 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   board.h
+ * Author: Ian
+ *
+ * Selects the description of the board the firmware is built for.
+ * Other boards are added here and selected by defining BOARD_SELECTED and 
+ * their BOARD_ macro in the project settings. The CANPAN is the default.
+ * 
+ * A board description header provides:
+ *   BOARD_SECTIONS             initialiser for the Section mapping table
+ *   BOARD_SWITCH_SECTIONS      initialiser for the switch to section table
+ * and the IO for scanning the 8 row x 4 column switch matrices and the 
+ * 4 anode x 8 cathode LED matrices:
+ *   BOARD_SWITCH_INIT()                set up the switch matrix IO
+ *   BOARD_SELECT_SWITCH_ROW(r)         drive row r (0-7) of all the switch matrices
+ *   BOARD_READ_SWITCH_COLUMNS_<m>()    read the 4 columns of switch matrix m
+ *   BOARD_LED_INIT()                   set up the LED matrix IO
+ *   BOARD_LED_DISABLE()                turn all the LEDs off
+ *   BOARD_LED_ENABLE()                 turn the LEDs back on
+ *   BOARD_LED_SEND_CATHODES(c)         send one matrix's cathodes, the last matrix first
+ *   BOARD_LED_LATCH()                  latch the cathodes that have been sent
+ *   BOARD_LED_ANODES(r)                the value for BOARD_LED_SELECT_ANODES() to drive anode r (0-3)
+ *   BOARD_LED_SELECT_ANODES(a)         drive the anodes
+ * These are expanded inline with constant arguments wherever possible so the
+ * scan code is specialised to the board at compile time.
+ * BOARD_HOST is the panel emulated by the host build in host/.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef BOARD_H
+#define	BOARD_H
+
+#ifndef BOARD_SELECTED
+#define BOARD_CANPAN
+#endif
+
+#ifdef BOARD_CANPAN
+#include "canpan.h"
+#endif
+
+#ifdef BOARD_HOST
+#include "hostboard.h"
+#endif
+
+#endif	/* BOARD_H */
+
@@ -0,0 +1,291 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   bulkNv.c
+ * Author: Ian
+ * 
+ * Read and write many NVs in one transaction using CBUS long messages. 
+ * See bulkNv.h for the message formats.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "cbus.h"
+#include "FliM.h"
+#include "EEPROM.h"
+#include "cabdcNv.h"
+#include "bulkNv.h"
+#ifdef NV_CACHE
+#include "nvCache.h"
+#endif
+#ifdef FRAME_TRACE
+#include "trace.h"
+#endif
+
+#ifndef CMDERR_INV_NV_VALUE
+#define CMDERR_INV_NV_VALUE     11
+#endif
+
+#define BULK_NV_IDLE        0
+#define BULK_NV_RECEIVING   1
+#define BULK_NV_SENDING     2
+
+static BYTE bulkState;
+static BYTE bulkBuffer[BULK_NV_BUFFER_LEN];
+static BYTE bulkLength;         // message length
+static BYTE bulkCount;          // number of message bytes received or sent so far
+static BYTE bulkSeq;            // next sequence number
+static WORD bulkCrc;
+static TickValue bulkTime;      // last frame received or sent
+
+static void processBulkNvMessage(void);
+static void bulkNvWrite(void);
+static void bulkNvRead(void);
+#ifdef FRAME_TRACE
+static void bulkTraceRead(void);
+#endif
+
+void initBulkNv(void) {
+    bulkState = BULK_NV_IDLE;
+}
+
+/**
+ * Calculate the CRC of a long message.
+ */
+WORD bulkNvCrc(BYTE * data, BYTE len) {
+    WORD crc = 0;
+    unsigned char i;
+    
+    while (len--) {
+        crc ^= ((WORD)*data++) << 8;
+        for (i=0; i<8; i++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+/**
+ * Handle a received DTXC frame.
+ * @param msg the DTXC message
+ */
+void bulkNvReceive(BYTE * msg) {
+    unsigned char i;
+    
+    if (msg[d1] != BULK_NV_STREAM_ID) return;
+    if (bulkState == BULK_NV_SENDING) return;     // buffer is busy
+    
+    if (msg[d2] == 0) {
+        // header frame starts a new message
+        bulkState = BULK_NV_IDLE;
+        if ((msg[d3] != 0) || (msg[d4] < BULK_NV_HEADER_LEN) || (msg[d4] > BULK_NV_BUFFER_LEN)) return;
+        bulkLength = msg[d4];
+        bulkCrc = ((WORD)msg[d5] << 8) | msg[d6];
+        bulkCount = 0;
+        bulkSeq = 1;
+        bulkState = BULK_NV_RECEIVING;
+        bulkTime.Val = tickGet();
+        return;
+    }
+    if (bulkState != BULK_NV_RECEIVING) return;
+    if (msg[d2] != bulkSeq) {
+        // missed a frame so give up on this message
+        bulkState = BULK_NV_IDLE;
+        return;
+    }
+    bulkSeq++;
+    bulkTime.Val = tickGet();
+    for (i=0; (i<BULK_NV_FRAME_LEN) && (bulkCount < bulkLength); i++) {
+        bulkBuffer[bulkCount++] = msg[d3+i];
+    }
+    if (bulkCount == bulkLength) {
+        bulkState = BULK_NV_IDLE;
+        if (bulkNvCrc(bulkBuffer, bulkLength) == bulkCrc) {
+            processBulkNvMessage();
+        }
+    }
+}
+
+/**
+ * A complete message has been received with a good CRC. Check it is for us
+ * and act upon it.
+ */
+static void processBulkNvMessage(void) {
+    BYTE nnMsg[sizeof(CanPacket)];     // only the NN is filled in, for thisNN()
+    
+    if (flimState == fsSLiM) return;
+    nnMsg[d1] = bulkBuffer[1];
+    nnMsg[d2] = bulkBuffer[2];
+    if ( ! thisNN(nnMsg)) return;
+#ifdef FRAME_TRACE
+    if (bulkBuffer[0] == BULK_TRACE_READ) {
+        bulkTraceRead();
+        return;
+    }
+#endif
+    if (((WORD)bulkBuffer[3] + bulkBuffer[4]) > NV_NUM) {
+        cbusMsg[d3] = CMDERR_INV_NV_IDX;
+        cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg);
+        return;
+    }
+    switch (bulkBuffer[0]) {
+        case BULK_NV_WRITE:
+            if (bulkLength == BULK_NV_HEADER_LEN + bulkBuffer[4]) {
+                bulkNvWrite();
+            }
+            break;
+        case BULK_NV_READ:
+            bulkNvRead();
+            break;
+    }
+}
+
+/**
+ * Validate all the NVs in the message and, if they are all good, change them
+ * and write them to flash.
+ */
+static void bulkNvWrite(void) {
+    BYTE first = bulkBuffer[3];
+    BYTE count = bulkBuffer[4];
+    BYTE * values = bulkBuffer + BULK_NV_HEADER_LEN;
+    BYTE oldValue;
+    unsigned char i;
+    
+    if (first == NV_VERSION) {
+        // the version is not writeable
+        cbusMsg[d3] = CMDERR_INV_NV_IDX;
+        cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg);
+        return;
+    }
+    for (i=0; i<count; i++) {
+        if ( ! validateNV(first+i, (BYTE)readNodeVar(first+i), values[i])) {
+            cbusMsg[d3] = CMDERR_INV_NV_VALUE;
+            cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg);
+            return;
+        }
+    }
+    for (i=0; i<count; i++) {
+        oldValue = (BYTE)readNodeVar(first+i);
+        if (oldValue != values[i]) {
+            writeNodeVar(first+i, values[i]);
+            actUponNVchange(first+i, oldValue, values[i]);
+        }
+    }
+#ifdef NV_CACHE
+    flushNvCache();
+#endif
+    cbusSendOpcMyNN(0, OPC_WRACK, cbusMsg);
+}
+
+/**
+ * Build the reply to a read request. It is sent by pollBulkNv().
+ */
+static void bulkNvRead(void) {
+    BYTE first = bulkBuffer[3];
+    BYTE count = bulkBuffer[4];
+    WORD nn;
+    unsigned char i;
+    
+    nn = ee_read_short((WORD)EE_NODE_ID);
+    bulkBuffer[0] = BULK_NV_DATA;
+    bulkBuffer[1] = nn >> 8;
+    bulkBuffer[2] = nn & 0xFF;
+    for (i=0; i<count; i++) {
+        bulkBuffer[BULK_NV_HEADER_LEN + i] = (BYTE)readNodeVar(first+i);
+    }
+    bulkLength = BULK_NV_HEADER_LEN + count;
+    bulkCrc = bulkNvCrc(bulkBuffer, bulkLength);
+    bulkCount = 0;
+    bulkSeq = 0;
+    bulkState = BULK_NV_SENDING;
+}
+
+#ifdef FRAME_TRACE
+// entries of the frame trace which fit in one reply, which is at most 255 bytes
+#define BULK_TRACE_ENTRIES  ((BULK_NV_BUFFER_LEN > 255 ? 255 - BULK_NV_HEADER_LEN : BULK_NV_BUFFER_LEN - BULK_NV_HEADER_LEN) / TRACE_ENTRY_LEN)
+
+/**
+ * Build the reply to a trace read. It is sent by pollBulkNv().
+ */
+static void bulkTraceRead(void) {
+    BYTE max = bulkBuffer[4];
+    WORD nn;
+    
+    if (max > BULK_TRACE_ENTRIES) max = BULK_TRACE_ENTRIES;
+    nn = ee_read_short((WORD)EE_NODE_ID);
+    bulkBuffer[0] = BULK_TRACE_DATA;
+    bulkBuffer[1] = nn >> 8;
+    bulkBuffer[2] = nn & 0xFF;
+    bulkBuffer[4] = traceRead(bulkBuffer[3], max, bulkBuffer + BULK_NV_HEADER_LEN);
+    bulkLength = BULK_NV_HEADER_LEN + bulkBuffer[4] * TRACE_ENTRY_LEN;
+    bulkCrc = bulkNvCrc(bulkBuffer, bulkLength);
+    bulkCount = 0;
+    bulkSeq = 0;
+    bulkState = BULK_NV_SENDING;
+}
+#endif
+
+/**
+ * Call regularly to send the frames of a read reply and to time out 
+ * incomplete transfers.
+ */
+void pollBulkNv(void) {
+    unsigned char i;
+    
+    switch (bulkState) {
+        case BULK_NV_RECEIVING:
+            if (tickTimeSince(bulkTime) > BULK_NV_TIMEOUT) {
+                bulkState = BULK_NV_IDLE;
+            }
+            break;
+        case BULK_NV_SENDING:
+            if ((bulkSeq != 0) && (tickTimeSince(bulkTime) < BULK_NV_FRAME_GAP)) break;
+            cbusMsg[d0] = OPC_DTXC;
+            cbusMsg[d1] = canID;
+            cbusMsg[d2] = bulkSeq;
+            if (bulkSeq == 0) {
+                cbusMsg[d3] = 0;
+                cbusMsg[d4] = bulkLength;
+                cbusMsg[d5] = bulkCrc >> 8;
+                cbusMsg[d6] = bulkCrc & 0xFF;
+                cbusMsg[d7] = 0;
+            } else {
+                for (i=0; i<BULK_NV_FRAME_LEN; i++) {
+                    cbusMsg[d3+i] = (bulkCount < bulkLength) ? bulkBuffer[bulkCount++] : 0;
+                }
+            }
+            cbusSendMsg(ALL_CBUS, cbusMsg);
+            bulkSeq++;
+            bulkTime.Val = tickGet();
+            if (bulkCount >= bulkLength) {
+                bulkState = BULK_NV_IDLE;
+            }
+            break;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   bulkNv.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef BULKNV_H
+#define	BULKNV_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "cabdcNv.h"
+
+/*
+ * Bulk transfer of NVs using CBUS long messages (DTXC).
+ * 
+ * Each long message is a header frame followed by data frames:
+ *   DTXC <stream> 0 <length hi> <length lo> <crc hi> <crc lo> <flags>
+ *   DTXC <stream> <seq> <5 bytes of message>
+ * The CRC is CRC-16/XMODEM (polynomial 0x1021, initial value 0) of the message.
+ * 
+ * Requests are sent to stream BULK_NV_STREAM_ID. The message is:
+ *   <command> <NN hi> <NN lo> <first NV> <count> [<NV values>...]
+ * 
+ * BULK_NV_WRITE sets count NVs starting at first NV. All the values are validated 
+ * before any are changed and they are then written to flash in one go. A WRACK
+ * is returned on success and a CMDERR if an NV index or value is not valid.
+ * No response is sent if the CRC is wrong or a frame is missing.
+ * 
+ * BULK_NV_READ returns a BULK_NV_DATA message with the requested NVs. This is 
+ * sent on a stream numbered with our CANID so that replies from different 
+ * modules can't be mixed up.
+ * 
+ * BULK_TRACE_READ and BULK_TRACE_DATA read the frame trace in the same way, 
+ * see trace.h.
+ */
+#ifndef OPC_DTXC
+#define OPC_DTXC            0xE9
+#endif
+
+#define BULK_NV_STREAM_ID   0xDC
+
+#define BULK_NV_WRITE       'W'
+#define BULK_NV_READ        'R'
+#define BULK_NV_DATA        'D'
+#define BULK_TRACE_READ     'T'
+#define BULK_TRACE_DATA     'F'
+
+#define BULK_NV_HEADER_LEN  5
+#define BULK_NV_BUFFER_LEN  (BULK_NV_HEADER_LEN + NV_NUM)
+#define BULK_NV_FRAME_LEN   5               // message bytes in each data frame
+    
+#define BULK_NV_TIMEOUT     ONE_SECOND      // abandon a transfer if a frame doesn't arrive in this time
+#define BULK_NV_FRAME_GAP   (2*ONE_MILI_SECOND)     // time between our transmitted frames
+
+extern void initBulkNv(void);
+extern void bulkNvReceive(BYTE * msg);
+extern void pollBulkNv(void);
+extern WORD bulkNvCrc(BYTE * data, BYTE len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* BULKNV_H */
+
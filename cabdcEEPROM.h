@@ -55,8 +55,20 @@ extern "C" {
     /**
      * Record the current output state for all the IO.
      */
-#define EE_OP_STATE         ((WORD)(EE_APPLICATION)-17)    // Space to store current state of up to 16 outputs
-                                                 // You'll need to do ee_read(EE_OP_STATE + io)
+#define EE_OP_STATE         ((WORD)(EE_APPLICATION)-17)    // Bitmap of the sections we control, 2 bytes
+#define EE_OP_STATE_HIGH    ((WORD)(EE_APPLICATION)-21)    // and sections 31-16 if there are more than 16
+    /**
+     * Number of times the NV flash blocks have been erased and written.
+     */
+#define EE_NV_ERASE_COUNT   ((WORD)(EE_APPLICATION)-19)    // 2 bytes
+    /**
+     * Results of the last CAN loopback test, see tests.h.
+     */
+#define EE_LOOPBACK_RESULTS ((WORD)(EE_APPLICATION)-33)    // LOOPBACK_RESULTS words
+    /**
+     * Results of the last potentiometer noise test, see tests.h.
+     */
+#define EE_NOISE_RESULTS    ((WORD)(EE_APPLICATION)-41)    // NOISE_RESULTS words
     
 
 #ifdef	__cplusplus
@@ -46,6 +46,7 @@
 #include "cbus.h"
 #include "FliM.h"
 #include "sections.h"
+#include "latency.h"
 
 
 extern BOOL	thisNN( BYTE *rx_ptr);
@@ -53,6 +54,9 @@ extern BOOL	thisNN( BYTE *rx_ptr);
 
 static TickValue startWait;
 
+// Fails to compile if the event table doesn't fit in the flash reserved for it
+typedef char eventTableFits[(sizeof(EventTable)*NUM_EVENTS <= EVENT_TABLE_SPACE) ? 1 : -1];
+
 void cabdcEventsInit(void) {
     startWait.Val = 0;
 }
@@ -89,8 +93,9 @@ BOOL getDefaultProducedEvent(HAPPENING_T happening) {
  * @param msg the full CBUS message so that OPC  and DATA can be retrieved.
  */
 void processEvent(BYTE tableIndex, BYTE * msg) {
-   // check if the nn is me and therefore if this is a self-consumed event
+    recordRxLatency();
     
+   // check if the nn is me and therefore if this is a self-consumed event
     if (thisNN(msg)) {
         // unusually we don't want to handle our own events
         return;
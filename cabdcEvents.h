@@ -84,17 +84,23 @@ extern void clearEvents(unsigned char i);
 
 // These are chosen so we don't use too much memory 32*20 = 640 bytes.
 // Used to size the hash table used to lookup events in the events2actions table.
-#define HASH_LENGTH     2
-#define CHAIN_LENGTH    2
+// The hash table is put in the large_event_hash RAM bank (712 bytes) by the linker script.
+#define HASH_LENGTH     32
+#define CHAIN_LENGTH    20
 
-#define NUM_EVENTS              2           // must be less than 256 otherwise loops fail
-#define EVENT_TABLE_WIDTH       1          // Width of eventTable
-#define EVperEVT                1          // Max number of EVs per event
+#define NUM_EVENTS              255         // must be less than 256 otherwise loops fail
+#define EVENT_TABLE_WIDTH       2          // Width of eventTable
+#define EVperEVT                2          // Max number of EVs per event
+#define EVENT_TABLE_SPACE       0x800       // Flash reserved for the event table. sizeof(EventTable)*NUM_EVENTS = 8*255 bytes
 #ifdef __18F25K80
-#define AT_EVENTS               0x7F00      //(AT_NV - sizeof(EventTable)*NUM_EVENTS) Size=256 * 22 = 5632(0x1600) bytes
+#define AT_EVENTS               0x7780      //(AT_NV - EVENT_TABLE_SPACE) Also change the persist CODEPAGE in the linker script
 #endif
 #ifdef __18F26K80
-#define AT_EVENTS               0xFF00      //(AT_NV - sizeof(EventTable)*NUM_EVENTS) Size=256 * 22 = 5632(0x1600) bytes
+#if NUM_SECTIONS > 16
+#define AT_EVENTS               0xF700      //(AT_NV - EVENT_TABLE_SPACE) below the larger NV area
+#else
+#define AT_EVENTS               0xF780      //(AT_NV - EVENT_TABLE_SPACE)
+#endif
 #endif
 
 // We'll also be using configurable produced events
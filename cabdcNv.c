@@ -49,6 +49,9 @@
 #endif
 #include "cbus.h"
 #include "analogue.h"
+#include "potentiometer.h"
+#include "sections.h"
+#include "switches.h"
 
 #ifdef __XC8
 const ModuleNvDefs moduleNvDefs @AT_NV; // = {    //  Allow 128 bytes for NVs. Declared const so it gets put into Flash
@@ -82,18 +85,48 @@ BOOL validateNV(unsigned char index, unsigned char oldValue, unsigned char value
         case NV_POT_DEAD_ZONE:
         case NV_POT_START_LEVEL:
         case NV_POT_END_LEVEL:
+        case NV_POT_HYSTERESIS:
         case NV_ACCELERATION:
             // These must be 0-127
             if (value & 0x80) {
                 return FALSE;
             }
             break;
+        case NV_ACK_ATTEMPTS:
+            // the backoff stops growing after a few attempts so keep the total bounded
+            if (value > 10) {
+                return FALSE;
+            }
+            break;
+        default:
+            if ((index >= NV_GROUP_START) && (index < NV_GROUP_START + NUM_GROUPS*NVS_PER_GROUP) 
+                    && ((index - NV_GROUP_START) % NVS_PER_GROUP == NV_GROUP_SWITCH_OFFSET)) {
+                if ((value >= NUM_SWITCHES) && (value != NV_GROUP_NO_SWITCH)) {
+                    return FALSE;
+                }
+            }
+            break;
     }
     return TRUE;
 } 
 
+/**
+ * An NV has been changed. Throw away anything which has been worked out from 
+ * its old value.
+ */
 void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char value) {
-
+    switch (index) {
+        case NV_POT_DEAD_ZONE:
+        case NV_POT_START_LEVEL:
+        case NV_POT_END_LEVEL:
+            invalidateSpeedTable();
+            break;
+        default:
+            if ((index >= NV_SECTION_START) && (index < NV_SECTION_START + NUM_SECTIONS*NVS_PER_SECTION)) {
+                invalidateSectionLookup();
+            }
+            break;
+    }
 }
 
 
@@ -102,27 +135,38 @@ void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char
  */
 void factoryResetGlobalNv(void) {
     unsigned char i;
+    unsigned char b;
     
-    writeFlashByte((BYTE*)(AT_NV + NV_SOD_DELAY), (BYTE)0);
-    writeFlashByte((BYTE*)(AT_NV + NV_POT_DEAD_ZONE), (BYTE)10);
-    writeFlashByte((BYTE*)(AT_NV + NV_POT_START_LEVEL), (BYTE)5);
-    writeFlashByte((BYTE*)(AT_NV + NV_POT_END_LEVEL), (BYTE)127);
-    writeFlashByte((BYTE*)(AT_NV + NV_ACCELERATION), (BYTE)1);
-    writeFlashByte((BYTE*)(AT_NV + NV_FREQUENCY), (BYTE)1);
-    writeFlashByte((BYTE*)(AT_NV + NV_FLAGS), (BYTE)(NV_FLAG_MASTER_PANEL | NV_FLAG_STOP_ON_RELEASE ));
-    writeFlashByte((BYTE*)(AT_NV + NV_SYNC_TX), (BYTE)0);
+    // With the NV cache these only change the cache. The caller flushes it.
+    writeNodeVar(NV_VERSION, FLASH_VERSION);
+    writeNodeVar(NV_SOD_DELAY, 0);
+    writeNodeVar(NV_POT_DEAD_ZONE, 10);
+    writeNodeVar(NV_POT_START_LEVEL, 5);
+    writeNodeVar(NV_POT_END_LEVEL, 127);
+    writeNodeVar(NV_ACCELERATION, 1);
+    writeNodeVar(NV_FREQUENCY, 1);
+    writeNodeVar(NV_FLAGS, NV_FLAG_MASTER_PANEL | NV_FLAG_STOP_ON_RELEASE);
+    writeNodeVar(NV_SYNC_TX, 0);
+    writeNodeVar(NV_STARTUP_MAX, 20);
+    writeNodeVar(NV_POT_HYSTERESIS, 0);
+    writeNodeVar(NV_LEASE_TIME, 0);
+    writeNodeVar(NV_ACK_ATTEMPTS, 0);
     
     // Now reset the per section NVs
     for (i=0; i< NUM_SECTIONS; i++) {
-        writeFlashByte((BYTE*)(AT_NV + NV_SECTION_NN_H(i)), (BYTE)0);
-        writeFlashByte((BYTE*)(AT_NV + NV_SECTION_NN_L(i)), (BYTE)0);
-        writeFlashByte((BYTE*)(AT_NV + NV_SECTION_EN_H(i)), (BYTE)0);
-        writeFlashByte((BYTE*)(AT_NV + NV_SECTION_EN_L(i)), (BYTE)(i%4));   // CAN4DC uses EN 0-3
+        writeNodeVar(NV_SECTION_NN_H(i), 0);
+        writeNodeVar(NV_SECTION_NN_L(i), 0);
+        writeNodeVar(NV_SECTION_EN_H(i), 0);
+        writeNodeVar(NV_SECTION_EN_L(i), i%4);   // CAN4DC uses EN 0-3
     }
-
-#ifdef NV_CACHE
-    loadNvCache();
-#endif
+    for (i=0; i< NUM_GROUPS; i++) {
+        writeNodeVar(NV_GROUP_SWITCH(i), NV_GROUP_NO_SWITCH);
+        for (b=0; b<SECTION_MASK_BYTES; b++) {
+            writeNodeVar(NV_GROUP_MASK(i, b), 0);
+        }
+    }
+    invalidateSpeedTable();
+    invalidateSectionLookup();
 }
 
 
@@ -63,10 +63,10 @@ extern "C" {
 #define NV_FREQUENCY                    6
 #define NV_FLAGS                        7
 #define NV_SYNC_TX                      8
-#define NV_SPARE2                       9
-#define NV_SPARE3                       10
-#define NV_SPARE4                       11
-#define NV_SPARE5                       12
+#define NV_STARTUP_MAX                  9
+#define NV_POT_HYSTERESIS               10
+#define NV_LEASE_TIME                   11
+#define NV_ACK_ATTEMPTS                 12
 #define NV_SPARE6                       13
 #define NV_SPARE7                       14
 #define NV_SPARE8                       15
@@ -85,12 +85,25 @@ extern "C" {
 #define NV_SECTION_EN_H(i)              (NV_SECTION_START + NVS_PER_SECTION*(i) + NV_SECTION_EN_H_OFFSET)
 #define NV_SECTION_EN_L(i)              (NV_SECTION_START + NVS_PER_SECTION*(i) + NV_SECTION_EN_L_OFFSET)
 
+#define NV_GROUP_START                  (NV_SECTION_START + NVS_PER_SECTION*NUM_SECTIONS)
+#define NVS_PER_GROUP                   (1 + SECTION_MASK_BYTES)
+
+// NVs per GROUP
+#define NV_GROUP_SWITCH_OFFSET          0
+#define NV_GROUP_MASK_OFFSET            1   // highest byte first
+
+#define NV_GROUP_SWITCH(i)              (NV_GROUP_START + NVS_PER_GROUP*(i) + NV_GROUP_SWITCH_OFFSET)
+#define NV_GROUP_MASK(i, b)             (NV_GROUP_START + NVS_PER_GROUP*(i) + NV_GROUP_MASK_OFFSET + (b))
+
+#define NV_GROUP_NO_SWITCH              0xFF    // group is not used. Also the erased value.
+
 #define SECTION_NV(i)                   ((unsigned char)((i-NV_IO_START)/NVS_PER_SECTION))
 #define NV_NV(i)                        ((unsigned char)((i-NV_IO_START)%NVS_PER_SECTION))
   
 // Flags
 #define NV_FLAG_MASTER_PANEL        1   // if set then we can forceably take control
 #define NV_FLAG_STOP_ON_RELEASE     2   // if set then send a stop when releasing
+#define NV_FLAG_TAKE_SEQUENCE       4   // if set then a section is also taken and released with an ACDAT which settles ties
     
 
 typedef struct {
@@ -105,12 +118,17 @@ typedef struct {
     } section_en_bytes;
 } NvSection;
 
+typedef struct {
+    unsigned char group_switch;         // switch which takes or releases the group
+    unsigned char group_mask[SECTION_MASK_BYTES];   // sections in the group, highest first
+} NvGroup;
+
 /*
  * This structure is required by FLiM.h
  */
 typedef struct {
         BYTE nv_version;                // 0 version of NV structure
-        BYTE sendSodDelay;              // 1 Time after start in 100mS (plus 2 seconds) to send an automatic SoD. Set to zero for no auto SoD
+        BYTE sendSodDelay;              // 1 Time after the bus is ready in 100mS to send an automatic SoD. Set to zero for no auto SoD
         BYTE pot_dead_zone;             // 2
         BYTE pot_start_level;           // 3
         BYTE pot_end_level;             // 4
@@ -118,8 +136,13 @@ typedef struct {
         BYTE frequency;                 // 6
         BYTE flags;                     // 7 flags
         BYTE sync_tx;                   // 8
-        BYTE spare[7];
+        BYTE startup_max;               // 9 Maximum time in 100mS to wait for the bus to settle at startup
+        BYTE pot_hysteresis;            // 10 Pot changes of this much or less are taken as noise. 0xFF is 0
+        BYTE lease_time;                // 11 Seconds before another panel's control lapses unless renewed. 0 or 0xFF for never
+        BYTE ack_attempts;              // 12 Times a take or release is sent until another panel acknowledges it. 0 or 0xFF for unacknowledged
+        BYTE spare[3];
         NvSection sections[NUM_SECTIONS];                 // config for each IO
+        NvGroup groups[NUM_GROUPS];                       // sections taken together
 } ModuleNvDefs;
 
 #define NV_NUM  sizeof(ModuleNvDefs)    // Number of node variables
@@ -128,12 +151,29 @@ typedef struct {
 #define AT_NV   0x7F80                  // Where the NVs are stored. (_ROMSIZE - 128)  Size=128 bytes
 #endif
 #ifdef __18F26K80
+#if NUM_SECTIONS > 16
+#define AT_NV   0xFF00                  // Where the NVs are stored. (_ROMSIZE - 256)  Size=256 bytes
+#else
 #define AT_NV   0xFF80                  // Where the NVs are stored. (_ROMSIZE - 128)  Size=128 bytes
 #endif
+#endif
 
 extern void cabdcNvInit(void);
-extern unsigned int getNodeVar(unsigned int index);
+extern unsigned int getNodeVar(unsigned int index);             // provided by the CBUS library
 extern void setNodeVar(unsigned int index, unsigned int value);
+/*
+ * The module reads and changes NVs with these. With NV_CACHE they go through
+ * the cache in nvCache.c, otherwise to the library which works on the flash.
+ */
+#ifdef NV_CACHE
+extern unsigned int getCachedNodeVar(unsigned int index);
+extern void setCachedNodeVar(unsigned int index, unsigned int value);
+#define readNodeVar(index)          getCachedNodeVar(index)
+#define writeNodeVar(index, value)  setCachedNodeVar(index, value)
+#else
+#define readNodeVar(index)          getNodeVar(index)
+#define writeNodeVar(index, value)  setNodeVar(index, value)
+#endif
 extern BOOL validateNV(BYTE nvIndex, BYTE oldValue, BYTE value);
 void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char value);
 extern void defaultNVs(unsigned char i, unsigned char type);        
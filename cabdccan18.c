@@ -59,6 +59,7 @@
 
 #include "can18.h"
 #include "cbus.h"
+#include "cabdccan18.h"
 #include <string.h>
 #ifdef __18CXX
 #pragma udata CANTX_FIFO
@@ -68,11 +69,13 @@ far CanPacket canTxFifo[CANTX_FIFO_LEN];
 #pragma udata CANRX_FIFO
 
 far CanPacket canRxFifo[CANRX_FIFO_LEN];
+far WORD canRxFifoTimestamp[CANRX_FIFO_LEN];     // SOF capture time of each frame in canRxFifo
 
 #pragma udata
 #else
 CanPacket canTxFifo[CANTX_FIFO_LEN];
 CanPacket canRxFifo[CANRX_FIFO_LEN];
+WORD canRxFifoTimestamp[CANRX_FIFO_LEN];
 #endif
 
 BYTE txIndexNextFree;
@@ -93,6 +96,37 @@ BYTE  rxOflowCount;
 BYTE  txFifoUsage;
 BYTE  rxFifoUsage;
 
+// CCP1 captures of TMR1 at each start of frame, waiting to be paired with a hardware buffer
+WORD  captureRing[CAN_CAPTURE_RING_LEN];
+BYTE  captureIndexNextFree;
+BYTE  captureIndexNextUsed;
+WORD  canRxTimestamp;
+
+// ECAN error state tracking and bus off recovery
+BYTE  canErrorState;
+BYTE  busOffCount;
+BYTE  errorPassiveCount;
+BYTE  maxTxErrCount;
+BYTE  busOffBackoff;            // hundreds of ms to wait before next restart attempt
+BOOL  busOffFlushRequired;
+WORD  busOffRecoveryTime;       // ms from entering bus off to resuming the last time
+TickValue  busOffStartTime;
+TickValue  busOffRetryTime;
+
+// Startup check of the saved CANID
+BYTE  canIdProbeState;
+BOOL  canIdConflict;
+BOOL  canIdProbeRtrSent;
+BOOL  canLoopbackMode;
+TickValue  canIdProbeStartTime;
+DWORD canIdProbeRtrDelay;       // when in the probe to send our RTR, staggered by node number
+
+TickValue  canLastRxTime;       // when any frame was last seen on the bus
+BYTE  canRxFrameCount;          // frames seen on the bus, wrapping, for the bus load
+
+// Transmission is held whilst bus off or whilst still checking our CANID is free
+#define CAN_TX_ALLOWED()    ((canErrorState != CAN_BUS_OFF) && (canIdProbeState == CANID_PROBE_IDLE))
+
 TickValue   enumerationStartTime;
 BOOL    enumerationRequired;
 BOOL    resultRequired;
@@ -106,7 +140,16 @@ BYTE  canID;
 static BYTE* _PointBuffer(BYTE b);
 void processEnumeration(void);
 BOOL checkIncomingPacket(CanPacket *ptr);
-BOOL insertIntoRxFifo( CanPacket *ptr );
+BOOL insertIntoRxFifo( CanPacket *ptr, WORD timestamp );
+WORD nextCaptureTimestamp(void);
+void canCaptureTimestamp(void);
+void processCanErrorState(void);
+void flushStaleTxFrames(void);
+BOOL isTxFrameSuperseded(BYTE index, BYTE remaining);
+void canRestart(void);
+void processCanIdProbe(void);
+void startCanIdProbe(BYTE state);
+void loadTxCanId(BYTE newCanId);
 
 extern BYTE    cbusMsg[sizeof(CanPacket)];
 
@@ -131,6 +174,19 @@ void canInit(BYTE busNum, BYTE initCanID) {
   rxIndexNextUsed = 0;
   txFifoUsage = 0;
   rxFifoUsage = 0;
+  captureIndexNextFree = 0;
+  captureIndexNextUsed = 0;
+  canRxTimestamp = 0;
+  canErrorState = CAN_ERROR_ACTIVE;
+  busOffCount = 0;
+  errorPassiveCount = 0;
+  maxTxErrCount = 0;
+  busOffBackoff = CAN_BUS_OFF_MIN_BACKOFF;
+  busOffFlushRequired = FALSE;
+  busOffRecoveryTime = 0;
+  canIdProbeState = CANID_PROBE_IDLE;
+  canLoopbackMode = FALSE;
+  canLastRxTime.Val = tickGet();
 
   IPR5 = CAN_INTERRUPT_PRIORITY;    // CAN interrupts priority
 
@@ -138,7 +194,8 @@ void canInit(BYTE busNum, BYTE initCanID) {
   CANCON = 0b10000000;
   
   // Wait for config mode
-  while (CANSTATbits.OPMODE2 == 0);
+  while (CANSTATbits.OPMODE2 == 0)
+      ;
 
   /*
    * The CAN baud rate pre-scaler is preset by the bootloader, so this code is written to be clock speed independent.
@@ -184,7 +241,17 @@ void canInit(BYTE busNum, BYTE initCanID) {
   
   // Continue CAN initialisation from where bootloader left off
   
-  CIOCON    = 0b00100000;    // TX drives Vdd when recessive, CAN capture to CCP1 disabled
+  CIOCON    = 0b00110000;    // TX drives Vdd when recessive, CAN capture to CCP1 enabled
+
+  // TMR1 is the timebase for the receive timestamps. Fosc/4, 1:8 prescale, 16 bit read/write
+  T1CON     = 0b00110010;
+  TMR1H     = 0;
+  TMR1L     = 0;
+  T1CONbits.TMR1ON = 1;
+  CCPTMRSbits.C1TSEL = 0;    // CCP1 captures TMR1
+  CCP1CON   = 0b00000101;    // Capture mode, the capture event is the CAN message receive signal
+  IPR3bits.CCP1IP = (CAN_INTERRUPT_PRIORITY != 0);
+  PIR3bits.CCP1IF = 0;
 
 
 
@@ -255,6 +322,10 @@ void canInit(BYTE busNum, BYTE initCanID) {
 
       if (canID == 0xFF)
           canID = DEFAULT_CANID;
+#ifdef CANID_PROBE
+      else
+          startCanIdProbe(CANID_PROBE_LAST_GOOD);   // check the last good CANID is still free before using it
+#endif
   }
   else // use value passed to this routine
   {
@@ -298,7 +369,25 @@ void canInit(BYTE busNum, BYTE initCanID) {
 
   FIFOWMIE = 1;    // Enable Fifo 1 space left interrupt
   ERRIE = 1;       // Enable error interrupts
+  PIE3bits.CCP1IE = 1;  // Enable start of frame capture interrupts
+
+}
+
+//*******************************************************************************
+// Switch the ECAN into or out of loopback mode for the self test
+// Our own frames come back in loopback so must not start a self enumeration
+
+void canLoopback( BOOL on )
+{
+    BYTE mode;
+
+    mode = on ? 0b01000000 : 0;
+    canLoopbackMode = on;
+    if (on)
+        canIdProbeState = CANID_PROBE_IDLE;     // nothing can clash with us
 
+    CANCON = mode;
+    while ((CANSTAT & 0xE0) != mode);           // Wait for the mode change
 }
 
 // Set a new can id
@@ -307,19 +396,7 @@ BOOL setNewCanId( BYTE newCanId )
 
 {
     if ((newCanId >= 1) && (newCanId <= 99)) {
-        canID = newCanId;
-        TXB0SIDH &= 0b11110000;                // Clear canid bits
-        TXB0SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for CUBS packet transmissions
-        TXB0SIDL = ( newCanId & 0x07) << 5;
-
-        TXB1SIDH &= 0b11110000;                // Clear canid bits
-        TXB1SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for self enumeration frame transmission
-        TXB1SIDL = TXB0SIDL;
-
-        TXB2SIDH &= 0b11110000;               // Clear canid bits
-        TXB2SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for self enumeration frame transmission
-        TXB2SIDL = TXB0SIDL;
-
+        loadTxCanId(newCanId);
         ee_write((WORD)EE_CAN_ID, newCanId );       // Update saved value
         return TRUE;
     } else {
@@ -327,6 +404,25 @@ BOOL setNewCanId( BYTE newCanId )
     }
 }
 
+// Use a can id for transmissions without saving it
+
+void loadTxCanId( BYTE newCanId )
+
+{
+    canID = newCanId;
+    TXB0SIDH &= 0b11110000;                // Clear canid bits
+    TXB0SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for CUBS packet transmissions
+    TXB0SIDL = ( newCanId & 0x07) << 5;
+
+    TXB1SIDH &= 0b11110000;                // Clear canid bits
+    TXB1SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for self enumeration frame transmission
+    TXB1SIDL = TXB0SIDL;
+
+    TXB2SIDH &= 0b11110000;               // Clear canid bits
+    TXB2SIDH |= ((newCanId & 0x78) >>3);  // Set new can id for self enumeration frame transmission
+    TXB2SIDL = TXB0SIDL;
+}
+
 
 // Send a message from a buffer provided by the caller
 
@@ -365,7 +461,7 @@ BOOL canTX( CanPacket *msg )
  
   // On chip Transmit buffers do not work as a FIFO, so use just one buffer and implement a software fifo
 
-  if (((txIndexNextUsed == txIndexNextFree) || canTransmitFailed) && (!TXB0CONbits.TXREQ))  // check if software fifo empty and transmit buffer ready
+  if (((txIndexNextUsed == txIndexNextFree) || canTransmitFailed) && (!TXB0CONbits.TXREQ) && CAN_TX_ALLOWED())  // check if software fifo empty and transmit buffer ready
   {
      ptr = (BYTE*) & TXB0CON;
      memcpy(ptr, (void *) msg->buffer, msg->buffer[dlc] + 6);
@@ -416,7 +512,7 @@ BOOL canQueueRx( CanPacket *msg )
 
 {
     FIFOWMIE = 0;   // Disable high water mark interrupt so nothing will fiddle with FIFO
-    insertIntoRxFifo( msg );
+    insertIntoRxFifo( msg, canTimestampNow() );
     FIFOWMIE = 1;
     return TRUE;
 }
@@ -435,7 +531,7 @@ void checkTxFifo( void )
     {
         canTransmitTimeout.Val = 0;
         
-        if (txIndexNextUsed != txIndexNextFree)   // If data waiting in software fifo, and buffer ready
+        if ((txIndexNextUsed != txIndexNextFree) && CAN_TX_ALLOWED())   // If data waiting in software fifo, and buffer ready
         {
             ptr = (BYTE*) & TXB0CON;              // Dest is CAN transmit buffer
             memcpy(ptr, canTxFifo[txIndexNextUsed].buffer, canTxFifo[txIndexNextUsed].buffer[dlc] + 6);
@@ -501,6 +597,8 @@ BOOL canbusRecv(CanPacket *msg)
     FIFOWMIE = 0;  // Disable high watermark interrupt so ISR cannot fiddle with FIFOs or enumeration map
 
     processEnumeration();  // Start or finish canid enumeration if required
+    processCanErrorState(); // Track error passive and recover from bus off
+    processCanIdProbe();    // Finish checking our CANID at startup
 
  
     // Check for any messages in the software fifo, which the ISR will have filled if there has been a high watermark interrupt
@@ -508,6 +606,7 @@ BOOL canbusRecv(CanPacket *msg)
     if (rxIndexNextUsed != rxIndexNextFree)
     {
       memcpy(msg->buffer, canRxFifo[rxIndexNextUsed].buffer, canRxFifo[rxIndexNextUsed].buffer[dlc] + 6);
+      canRxTimestamp = canRxFifoTimestamp[rxIndexNextUsed];
       rxFifoUsage--;
       
       if (++rxIndexNextUsed >= CANRX_FIFO_LEN)
@@ -525,6 +624,11 @@ BOOL canbusRecv(CanPacket *msg)
         {
             ptr = (CanPacket*) _PointBuffer(CANCON & 0x07);
             RXBnIF = 0;
+            PIE3bits.CCP1IE = 0;
+            if (PIR3bits.CCP1IF)
+                canCaptureTimestamp();
+            canRxTimestamp = nextCaptureTimestamp();
+            PIE3bits.CCP1IE = 1;
 //            if (COMSTATbits.RXBnOVFL) {
 //              maxcanq++; // Buffer Overflow
 //              led3timer = 5;
@@ -534,7 +638,8 @@ BOOL canbusRecv(CanPacket *msg)
 
             // Check incoming Canid and initiate self enumeration if it is the same as our own
 
-            if (msgFound = checkIncomingPacket(ptr))
+            msgFound = checkIncomingPacket(ptr);
+            if (msgFound)
               memcpy(msg->buffer, (void*) ptr, ptr->buffer[dlc] + 6);  // Get message for processing
 
             // Record and Clear any previous invalid message bit flag.
@@ -557,10 +662,11 @@ BOOL canbusRecv(CanPacket *msg)
 // **************************************************************************
 // Insert a CAN packet into the next free location of the receive FIFO
 
-BOOL insertIntoRxFifo( CanPacket *ptr )
+BOOL insertIntoRxFifo( CanPacket *ptr, WORD timestamp )
 
 {
     memcpy(canRxFifo[rxIndexNextFree].buffer, ptr, ptr->buffer[dlc] + 6);
+    canRxFifoTimestamp[rxIndexNextFree] = timestamp;
     rxFifoUsage++;
 
     if (++rxIndexNextFree >= CANRX_FIFO_LEN)
@@ -589,13 +695,17 @@ void canFillRxFifo(void)
 {
   CanPacket *ptr;
   BYTE  hiIndex;
+  WORD  timestamp;
 
 
   while (COMSTATbits.NOT_FIFOEMPTY)
   {
+    if (PIR3bits.CCP1IF)    // make sure the capture for this frame is in the ring
+        canCaptureTimestamp();
 
     ptr = (CanPacket*) _PointBuffer(CANCON & 0x07);
     RXBnIF = 0;
+    timestamp = nextCaptureTimestamp();
     if (RXBnOVFL) {
    //   maxcan++; // Buffer Overflow
    //   led3timer = 5;
@@ -605,7 +715,7 @@ void canFillRxFifo(void)
 
     if (checkIncomingPacket(ptr))
     {
-        insertIntoRxFifo( ptr );
+        insertIntoRxFifo( ptr, timestamp );
 
         //   led3timer = 5;
         //   LED3 = LED_OFF;
@@ -626,9 +736,76 @@ void canFillRxFifo(void)
         maxCanRxFifo = hiIndex - rxIndexNextUsed;
 
   }  // While hardware FIFO not empty
+  // Any captures left over now belong to frames which were rejected by the
+  // acceptance filters so discard them to keep the ring in step with the buffers
+  captureIndexNextUsed = captureIndexNextFree;
   FIFOWMIF = 0;
 } // canFillRxFifo
 
+
+// **********************************************************************************
+// Read the current timestamp timebase. Called from both the main loop and the isr,
+// so interrupts are held off between the two reads in case an isr reads TMR1L and
+// overwrites the latched TMR1H, and then put back as they were.
+
+WORD canTimestampNow(void)
+{
+    WORD_VAL now;
+    BYTE gieh;
+    BYTE giel;
+
+    gieh = INTCONbits.GIEH;
+    giel = INTCONbits.GIEL;
+    INTCONbits.GIEH = 0;
+    INTCONbits.GIEL = 0;
+    now.v[0] = TMR1L;   // reading TMR1L latches TMR1H in 16 bit mode
+    now.v[1] = TMR1H;
+    INTCONbits.GIEL = giel;
+    INTCONbits.GIEH = gieh;
+    return now.Val;
+}
+
+
+// **********************************************************************************
+// Called from isr when CCP1 has captured the start of an incoming frame
+
+void canCaptureTimestamp(void)
+{
+    WORD_VAL capture;
+    BYTE next;
+
+    capture.v[0] = CCPR1L;
+    capture.v[1] = CCPR1H;
+    PIR3bits.CCP1IF = 0;
+
+    next = captureIndexNextFree + 1;
+    if (next >= CAN_CAPTURE_RING_LEN)
+        next = 0;
+    if (next != captureIndexNextUsed)   // if full drop the capture, frame will use the time it is read instead
+    {
+        captureRing[captureIndexNextFree] = capture.Val;
+        captureIndexNextFree = next;
+    }
+}
+
+
+// **********************************************************************************
+// Get the capture time for the hardware buffer about to be read. Captures are
+// taken in the order the frames are received so are paired with buffers in order.
+
+WORD nextCaptureTimestamp(void)
+{
+    WORD timestamp;
+
+    if (captureIndexNextUsed == captureIndexNextFree)
+        return canTimestampNow();       // no capture available
+
+    timestamp = captureRing[captureIndexNextUsed];
+    if (++captureIndexNextUsed >= CAN_CAPTURE_RING_LEN)
+        captureIndexNextUsed = 0;
+    return timestamp;
+}
+
 /* start a self enumeration */
 // don't set the start time so it should start on next main loop cycle
 void doEnum(BOOL sendResult) {
@@ -691,6 +868,96 @@ void processEnumeration(void)
 }  // Process enumeration
 
 
+//*******************************************************************************
+// Startup check of the CANID.
+// Rather than self enumerate when the saved CANID clashes, which is what
+// every module does after a layout wide power up, check it before
+// transmitting anything else. Part way through the check we send the
+// enumeration RTR carrying the CANID being checked, so every module on the
+// bus answers with its own CANID, and a panel checking the same CANID sees
+// our RTR. The point at which the RTR goes is staggered by node number so two
+// panels powered up together do not send identical RTRs at the same instant
+// and miss each other. We do not answer RTRs ourselves until the check is
+// over, as the answer would claim the CANID we are still checking.
+// If the last good CANID is in use try one derived from our node number.
+// Only if that is in use too do a full self enumeration.
+
+void startCanIdProbe( BYTE state )
+{
+    WORD    nodeNumber;
+
+    nodeNumber = ee_read_short((WORD)EE_NODE_ID);
+    if (nodeNumber == 0xFFFF)
+        nodeNumber = 0;
+    canIdProbeState = state;
+    canIdConflict = FALSE;
+    canIdProbeRtrSent = FALSE;
+    canIdProbeRtrDelay = (nodeNumber % CANID_PROBE_RTR_SLOTS) * CANID_PROBE_RTR_STAGGER;
+    canIdProbeStartTime.Val = tickGet();
+}
+
+void processCanIdProbe( void )
+{
+    BYTE    fallbackCanId;
+    WORD    nodeNumber;
+
+    if (canIdProbeState == CANID_PROBE_IDLE)
+        return;
+
+    if (!canIdProbeRtrSent && !canIdConflict && (tickTimeSince(canIdProbeStartTime) >= canIdProbeRtrDelay))
+    {
+        TXB1CONbits.TXREQ = 1;  // ask everyone for their CANID, which also shows ours to anyone checking it
+        canIdProbeRtrSent = TRUE;
+    }
+
+    if (tickTimeSince(canIdProbeStartTime) < CANID_PROBE_TIME)
+        return;
+
+    if (!canIdConflict)
+    {
+        if (canIdProbeState == CANID_PROBE_FALLBACK)
+            setNewCanId(canID);     // remember it as the last good CANID
+        canIdProbeState = CANID_PROBE_IDLE;
+    }
+    else if (canIdProbeState == CANID_PROBE_LAST_GOOD)
+    {
+        nodeNumber = ee_read_short((WORD)EE_NODE_ID);
+        fallbackCanId = (BYTE)(nodeNumber % 99) + 1;
+        if ((nodeNumber == 0) || (nodeNumber == 0xFFFF) || (fallbackCanId == canID))
+        {
+            canIdProbeState = CANID_PROBE_IDLE;
+            doEnum(FALSE);
+        }
+        else
+        {
+            loadTxCanId(fallbackCanId);
+            startCanIdProbe(CANID_PROBE_FALLBACK);
+        }
+    }
+    else
+    {
+        canIdProbeState = CANID_PROBE_IDLE;
+        doEnum(FALSE);
+    }
+
+    if (canIdProbeState == CANID_PROBE_IDLE)
+    {
+        TXBnIE = 0;
+        checkTxFifo();          // send anything queued whilst we were checking
+    }
+}
+
+
+//*******************************************************************************
+// Check whether CANIDs are still being sorted out, either by our startup
+// check or by a self enumeration.
+
+BOOL canIdSettling( void )
+{
+    return enumerationRequired || enumerationInProgress || (canIdProbeState != CANID_PROBE_IDLE);
+}
+
+
 //*******************************************************************************
 // Check incoming packet for RTR enumeration request, any canid clash and zero payload
 // Fills in bitmap with canid if self enumeration in progress
@@ -704,12 +971,18 @@ BOOL checkIncomingPacket(CanPacket *ptr)
 
     msgFound = FALSE;
     incomingCanId = ((ptr->buffer[sidh] << 3) + (ptr->buffer[sidl] >> 5)) & 0x7f;
+    canLastRxTime.Val = tickGet();
+    canRxFrameCount++;
 
-    if (enumerationInProgress) {
+    if (canIdProbeState != CANID_PROBE_IDLE) {
+        if (incomingCanId == canID)
+            canIdConflict = TRUE;   // the CANID we are checking is in use
+    } else if (enumerationInProgress) {
         arraySetBit( enumerationResults, incomingCanId);
-    } else if (!enumerationRequired && (incomingCanId == canID))    
+    } else if (!enumerationRequired && !canLoopbackMode && (incomingCanId == canID) && !(ptr->buffer[dlc] & 0x40))    
     {
         // If we receive a packet with our own canid, initiate enumeration as automatic conflict resolution (Thanks to Bob V for this idea)
+        // An RTR with our canid is a module checking or giving up that canid, which our reply will move on
         // we know enumerationInProgress = FALSE here
         doEnum(FALSE);
         enumerationStartTime.Val = tickGet();  // Start hold off time for self enumeration - start after 200ms delay
@@ -719,7 +992,8 @@ BOOL checkIncomingPacket(CanPacket *ptr)
 
     if (ptr->buffer[dlc] & 0x40 ) // RTR bit set?
     {
-        TXB2CONbits.TXREQ = 1;                  // Send enumeration response (zero payload frame preloaded in TXB2)
+        if (canIdProbeState == CANID_PROBE_IDLE)
+            TXB2CONbits.TXREQ = 1;              // Send enumeration response (zero payload frame preloaded in TXB2), not whilst our CANID is unchecked
         enumerationStartTime.Val = tickGet();   // re-Start hold off time for self enumeration
     }
     else
@@ -758,6 +1032,17 @@ void canTxError( void )
       TXB0CONbits.TXREQ = 0;
       txErrCount++;
     }
+    if (COMSTATbits.TXBO && (canErrorState != CAN_BUS_OFF)) {   // gone bus off
+        // Stop trying to transmit, the main loop will sort out the fifo and the recovery
+        canErrorState = CAN_BUS_OFF;
+        busOffCount++;
+        busOffStartTime.Val = tickGet();
+        busOffRetryTime.Val = busOffStartTime.Val;
+        busOffFlushRequired = TRUE;
+        canTransmitFailed = TRUE;
+        canTransmitTimeout.Val = 0;
+        TXB0CONbits.TXREQ = 0;
+    }
     
     if (canTransmitFailed)
         checkTxFifo();  // Check to see if more to try and send
@@ -766,6 +1051,154 @@ void canTxError( void )
 }
 
 
+//****************************************************************************
+// Called by main loop to follow the ECAN error state.
+// The ERRIF interrupt tells us when things get worse but not when they get
+// better so the state is polled here. When bus off the controller is
+// restarted with an increasing backoff in case the hardware recovery sequence
+// never completes, e.g. with a shorted bus.
+
+void processCanErrorState( void )
+{
+    BYTE    errCount;
+
+    errCount = TXERRCNT;
+    if (errCount > maxTxErrCount)
+        maxTxErrCount = errCount;
+
+    if (canErrorState == CAN_BUS_OFF)
+    {
+        if (busOffFlushRequired)
+        {
+            busOffFlushRequired = FALSE;
+            flushStaleTxFrames();
+        }
+        if (!COMSTATbits.TXBO)
+        {
+            // Back on the bus - restart transmission of whatever is still queued
+            busOffRecoveryTime = (tickTimeSince(busOffStartTime) > (0xFFFF * ONE_MILI_SECOND)) ?
+                    0xFFFF : (WORD)(tickTimeSince(busOffStartTime) / ONE_MILI_SECOND);
+            busOffBackoff = CAN_BUS_OFF_MIN_BACKOFF;
+            canErrorState = CAN_ERROR_ACTIVE;
+            canTransmitFailed = FALSE;
+            TXBnIE = 0;
+            checkTxFifo();
+        }
+        else if (tickTimeSince(busOffRetryTime) > (busOffBackoff * HUNDRED_MILI_SECOND))
+        {
+            canRestart();
+            busOffRetryTime.Val = tickGet();
+            if (busOffBackoff < CAN_BUS_OFF_MAX_BACKOFF)
+                busOffBackoff <<= 1;
+        }
+    }
+    if (canErrorState != CAN_BUS_OFF)
+    {
+        if (COMSTATbits.TXBP || COMSTATbits.RXBP)
+        {
+            if (canErrorState == CAN_ERROR_ACTIVE)
+                errorPassiveCount++;
+            canErrorState = CAN_ERROR_PASSIVE;
+        }
+        else
+        {
+            canErrorState = CAN_ERROR_ACTIVE;
+        }
+    }
+}
+
+
+//****************************************************************************
+// Restart the ECAN. Going through configuration mode resets the error
+// counters and so takes the controller out of bus off.
+
+void canRestart( void )
+{
+    TickValue   modeTime;
+
+    modeTime.Val = tickGet();
+    CANCON = 0b10000000;
+    while ((CANSTATbits.OPMODE2 == 0) && (tickTimeSince(modeTime) < (10 * ONE_MILI_SECOND)));
+    CANCON = 0;               // Set normal operation mode
+}
+
+
+//****************************************************************************
+// Remove frames from the transmit fifo which are no longer worth sending after
+// a bus off. Syncs are dropped and speed messages are dropped if a later speed 
+// message for the same section is queued. Everything else is kept in order.
+
+void flushStaleTxFrames( void )
+{
+    BYTE    count, kept, i, src, dst;
+
+    TXBnIE = 0;
+    if (txIndexNextFree == 0xFF)
+        count = CANTX_FIFO_LEN;
+    else if (txIndexNextFree >= txIndexNextUsed)
+        count = txIndexNextFree - txIndexNextUsed;
+    else
+        count = txIndexNextFree + CANTX_FIFO_LEN - txIndexNextUsed;
+
+    kept = 0;
+    for (i=0; i<count; i++)
+    {
+        src = txIndexNextUsed + i;
+        if (src >= CANTX_FIFO_LEN)
+            src -= CANTX_FIFO_LEN;
+        if (isTxFrameSuperseded(src, count-i-1))
+            continue;
+        dst = txIndexNextUsed + kept;
+        if (dst >= CANTX_FIFO_LEN)
+            dst -= CANTX_FIFO_LEN;
+        if (dst != src)
+            memcpy(canTxFifo[dst].buffer, canTxFifo[src].buffer, canTxFifo[src].buffer[dlc] + 6);
+        kept++;
+    }
+    txFifoUsage -= (count - kept);
+    if (kept == CANTX_FIFO_LEN)
+    {
+        txIndexNextFree = 0xFF;
+    }
+    else
+    {
+        txIndexNextFree = txIndexNextUsed + kept;
+        if (txIndexNextFree >= CANTX_FIFO_LEN)
+            txIndexNextFree -= CANTX_FIFO_LEN;
+    }
+    TXBnIE = 1;
+}
+
+// Check whether a queued frame can be discarded. remaining is the number of
+// frames queued after it.
+
+BOOL isTxFrameSuperseded( BYTE index, BYTE remaining )
+{
+    BYTE    later;
+    BYTE    opc;
+
+    opc = canTxFifo[index].buffer[d0];
+    if (opc == OPC_TON)
+        return TRUE;
+    if ((opc != OPC_ACON3) && (opc != OPC_ACOF3))
+        return FALSE;
+
+    later = index;
+    while (remaining--)
+    {
+        if (++later >= CANTX_FIFO_LEN)
+            later = 0;
+        if (((canTxFifo[later].buffer[d0] == OPC_ACON3) || (canTxFifo[later].buffer[d0] == OPC_ACOF3))
+                && (canTxFifo[later].buffer[d1] == canTxFifo[index].buffer[d1])
+                && (canTxFifo[later].buffer[d2] == canTxFifo[index].buffer[d2])
+                && (canTxFifo[later].buffer[d3] == canTxFifo[index].buffer[d3])
+                && (canTxFifo[later].buffer[d4] == canTxFifo[index].buffer[d4]))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+
 // This routine is called to manage the CAN interrupts.
 // It may be called directly from the ISR definition in the application, or it may be called from the MLA interrupt handler
 // via the applicationInterruptHandler routine
@@ -773,9 +1206,12 @@ void canTxError( void )
 
 void canInterruptHandler( void )
 {
+    if (PIR3bits.CCP1IF)    // Start of frame capture, must be recorded before the frame is read
+        canCaptureTimestamp();
+
     if (FIFOWMIF)       // Receive buffer high water mark, so move data into software fifo
         canFillRxFifo();
-    
+
     if (ERRIF) 
         canTxError();
     
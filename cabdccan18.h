@@ -0,0 +1,103 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/
+/*
+ * File:   cabdccan18.h
+ * Author: Ian
+ *
+ * Additions to the CBUS library can18.h interface which are specific to the
+ * modified CAN driver in cabdccan18.c.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef CABDCCAN18_H
+#define	CABDCCAN18_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "TickTime.h"
+
+/*
+ * Receive timestamps.
+ * The ECAN start of frame signal is routed to the CCP1 capture input which
+ * captures TMR1. TMR1 runs from Fosc/4 with a 1:8 prescaler so with a 16MHz
+ * clock each timestamp tick is 2us and the 16 bit value wraps every 131ms.
+ * Differences between two timestamps are valid as long as they are less than
+ * the wrap time.
+ */
+#define CAN_TIMESTAMP_US        2       // microseconds per timestamp tick
+#define CAN_CAPTURE_RING_LEN    8       // one per ECAN hardware receive buffer
+
+extern WORD canTimestampNow(void);
+extern WORD canRxTimestamp;             // timestamp of the message last returned by canbusRecv()
+
+/*
+ * ECAN error states as followed by processCanErrorState().
+ */
+#define CAN_ERROR_ACTIVE        0
+#define CAN_ERROR_PASSIVE       1
+#define CAN_BUS_OFF             2
+
+// Restart attempts while bus off, in 100ms units. Doubled after each attempt.
+#define CAN_BUS_OFF_MIN_BACKOFF 1
+#define CAN_BUS_OFF_MAX_BACKOFF 32
+
+extern BYTE canErrorState;
+extern BYTE busOffCount;
+extern BYTE errorPassiveCount;
+extern BYTE maxTxErrCount;              // highest TXERRCNT seen
+extern WORD busOffRecoveryTime;         // ms taken to recover from the last bus off
+
+/*
+ * Startup CANID check. See processCanIdProbe().
+ */
+#define CANID_PROBE_IDLE        0
+#define CANID_PROBE_LAST_GOOD   1       // checking the CANID saved in EEPROM
+#define CANID_PROBE_FALLBACK    2       // checking the CANID derived from the node number
+#define CANID_PROBE_TIME        (3*HUNDRED_MILI_SECOND)
+#define CANID_PROBE_RTR_SLOTS   8       // RTR sent after (node number % slots) * stagger
+#define CANID_PROBE_RTR_STAGGER (20*ONE_MILI_SECOND)
+
+extern BYTE canIdProbeState;
+extern BOOL canIdSettling(void);
+
+extern TickValue canLastRxTime;
+extern BYTE canRxFrameCount;
+
+/*
+ * Loopback for the CAN self test. Frames sent with canTX() are received back
+ * through the normal receive path without reaching the bus, and are not
+ * taken as another module using our CANID.
+ */
+extern BOOL canLoopbackMode;
+extern void canLoopback(BOOL on);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* CABDCCAN18_H */
+
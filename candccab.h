@@ -55,8 +55,28 @@ extern "C" {
 /*******************************************************************
  * IO pin configuration
  */
-// Number of sections supported
+// Number of sections supported. Each section uses two switches and two LEDs
+// so each 32 switch/32 LED matrix handles 16 sections. 
+#ifndef NUM_SECTIONS
 #define NUM_SECTIONS 16
+#endif
+#if (NUM_SECTIONS != 16) && (NUM_SECTIONS != 32)
+#error "NUM_SECTIONS must be 16 or 32"
+#endif
+#if (NUM_SECTIONS > 16) && defined(__18F25K80)
+#error "More than 16 sections needs the larger NV area of the 18F26K80"
+#endif
+#define SECTIONS_PER_MATRIX     16
+#define NUM_MATRICES            ((NUM_SECTIONS + SECTIONS_PER_MATRIX - 1) / SECTIONS_PER_MATRIX)
+#define NUM_LEDS                (32 * NUM_MATRICES)
+// Bytes needed for a bitmap of the sections
+#if NUM_SECTIONS > 16
+#define SECTION_MASK_BYTES      4
+#else
+#define SECTION_MASK_BYTES      2
+#endif
+// Number of groups of sections which can be taken with one switch
+#define NUM_GROUPS 4
 #define NUM_POTS 1
     
 // look in mioNv as the IO pin config is stored in NVs
@@ -71,6 +91,14 @@ extern "C" {
 #include "GenericTypeDefs.h"
 #include "cbusdefs.h"
 
+// A bitmap with one bit for each section
+#if NUM_SECTIONS > 16
+typedef DWORD SectionMask;
+#else
+typedef WORD SectionMask;
+#endif
+#define SECTION_BIT(s)  ((SectionMask)1 << (s))
+
 #define MANU_ID         MANU_MERG
 #define MODULE_ID       MTYP_CANCABDC 
 #define MODULE_TYPE     "CABDC  "       // MUST be at least 7 character long. First 7 are used.
@@ -82,6 +110,9 @@ extern "C" {
 
 // Time delays 
 #define CBUS_START_DELAY    TWO_SECOND
+#define STARTUP_MIN_TIME    (5*HUNDRED_MILI_SECOND)  // Earliest we start sending after power up
+#define STARTUP_LOAD_WINDOW HUNDRED_MILI_SECOND      // Bus load is measured over this long
+#define STARTUP_BUSY_FRAMES 30                       // Frames in a window above which the bus is still busy, about 30% at 125K
     
 #define ACTION_T   unsigned char
 #define HAPPENING_T   unsigned char
@@ -0,0 +1,117 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   canpan.h
+ * Author: Ian
+ *
+ * Board description of the CANPAN.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef CANPAN_H
+#define	CANPAN_H
+
+/*
+ * Each matrix handles 16 sections. Section j of matrix m uses:
+ *   request switch         32m + j
+ *   direction switch       32m + j + 16
+ *   our control LED        32m + 8 + j + (j/8)*8
+ *   other controlled LED   32m + j + (j/8)*8
+ * These are in the order of the fields of Section.
+ */
+#define CANPAN_SECTION(m, j)    { 32*(m)+(j), 32*(m)+(j)+16, 32*(m)+8+(j)+((j)/8)*8, 32*(m)+(j)+((j)/8)*8 }
+
+#define CANPAN_MATRIX_SECTIONS(m) \
+    CANPAN_SECTION(m, 0), \
+    CANPAN_SECTION(m, 1), \
+    CANPAN_SECTION(m, 2), \
+    CANPAN_SECTION(m, 3), \
+    CANPAN_SECTION(m, 4), \
+    CANPAN_SECTION(m, 5), \
+    CANPAN_SECTION(m, 6), \
+    CANPAN_SECTION(m, 7), \
+    CANPAN_SECTION(m, 8), \
+    CANPAN_SECTION(m, 9), \
+    CANPAN_SECTION(m, 10), \
+    CANPAN_SECTION(m, 11), \
+    CANPAN_SECTION(m, 12), \
+    CANPAN_SECTION(m, 13), \
+    CANPAN_SECTION(m, 14), \
+    CANPAN_SECTION(m, 15)
+
+// the section of each of the 32 switches of matrix m, request switches then direction switches
+#define CANPAN_MATRIX_SWITCHES(m) \
+    16*(m)+0, 16*(m)+1, 16*(m)+2, 16*(m)+3, 16*(m)+4, 16*(m)+5, 16*(m)+6, 16*(m)+7, 16*(m)+8, 16*(m)+9, 16*(m)+10, 16*(m)+11, 16*(m)+12, 16*(m)+13, 16*(m)+14, 16*(m)+15, \
+    16*(m)+0, 16*(m)+1, 16*(m)+2, 16*(m)+3, 16*(m)+4, 16*(m)+5, 16*(m)+6, 16*(m)+7, 16*(m)+8, 16*(m)+9, 16*(m)+10, 16*(m)+11, 16*(m)+12, 16*(m)+13, 16*(m)+14, 16*(m)+15
+
+#if NUM_MATRICES == 1
+#define BOARD_SECTIONS          CANPAN_MATRIX_SECTIONS(0)
+#define BOARD_SWITCH_SECTIONS   CANPAN_MATRIX_SWITCHES(0)
+#else
+#define BOARD_SECTIONS          CANPAN_MATRIX_SECTIONS(0), CANPAN_MATRIX_SECTIONS(1)
+#define BOARD_SWITCH_SECTIONS   CANPAN_MATRIX_SWITCHES(0), CANPAN_MATRIX_SWITCHES(1)
+#endif
+
+/*
+ * Switch matrix. RA0-RA2 select the row and RB0-RB3 are the columns.
+ * The columns of a second matrix need to be defined for the board by 
+ * BOARD_READ_SWITCH_COLUMNS_1().
+ */
+#define BOARD_SWITCH_INIT()             { TRISA = 0x28; /* RA0-RA2 are outputs RA3 is PB */ \
+                                          TRISB = 0xf; /* upper 4 bits are outputs, lower 4 are inputs */ }
+#define BOARD_SELECT_SWITCH_ROW(r)      LATA = (r)
+#define BOARD_READ_SWITCH_COLUMNS_0()   (PORTB & 0xf)
+#if (NUM_MATRICES > 1) && !defined(BOARD_READ_SWITCH_COLUMNS_1)
+#error "Define BOARD_READ_SWITCH_COLUMNS_1() for the second switch matrix"
+#endif
+
+/*
+ * LED matrix. RB4-RB7 drive the anodes. The MSSP shifts the cathodes into the
+ * cathode driver, further matrices' drivers being chained after the first. 
+ * RC2 is the driver OE and RC4 is LE.
+ */
+#define BOARD_LED_INIT()                { TRISC = 0x80; /* RC7 is the CAN Rx */ \
+                                          LATB = 0xF0;  /* LED drivers off */ \
+                                          TRISB = 0xf;  /* upper 4 bits are outputs, lower 4 are inputs */ \
+                                          SSPCON1 = 0x22; /* Enable Master and clock for Fosc/64 */ \
+                                          SSPSTATbits.CKE = 1; }
+#define BOARD_LED_DISABLE()             LATCbits.LATC2 = 1
+#define BOARD_LED_ENABLE()              LATCbits.LATC2 = 0
+/* 
+ * This takes quite a bit of time but we have to ensure the cathodes have the
+ * right data before turning on the anodes otherwise we don't get a clean display.
+ */
+#define BOARD_LED_SEND_CATHODES(c)      { unsigned char dummy; \
+                                          PIR1bits.SSPIF = 0; \
+                                          dummy = SSPBUF; /* dummy read needed before next write */ \
+                                          SSPCON1 = 0x22; \
+                                          PIR1bits.SSPIF = 0; \
+                                          SSPBUF = (c); \
+                                          while (PIR1bits.SSPIF == 0) ; }
+#define BOARD_LED_LATCH()               { LATCbits.LATC4 = 1; LATCbits.LATC4 = 0; }
+#define BOARD_LED_ANODES(r)             ((unsigned char)~(1 << (4+(r))) & 0xf0)
+#define BOARD_LED_SELECT_ANODES(a)      LATB = (a)
+
+#endif	/* CANPAN_H */
+
@@ -0,0 +1,163 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   diagnostics.c
+ * Author: Ian
+ * 
+ * Make the module's statistics readable over CBUS.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "cbus.h"
+#include "diagnostics.h"
+#include "latency.h"
+#include "cabdccan18.h"
+#include "sections.h"
+#include "cabdcEEPROM.h"
+#include "tests.h"
+#include "ownership.h"
+#include "sync.h"
+#ifdef NV_CACHE
+#include "nvCache.h"
+#endif
+
+extern WORD timeToReady;
+
+/**
+ * Handle a RDGN request addressed to this node and send the value back in a
+ * DGN response. Unknown codes are returned with a value of 0.
+ * @param msg the RDGN message
+ */
+void processDiagnosticRequest(BYTE * msg) {
+    WORD value;
+    
+    switch (msg[d4]) {
+        case DIAG_RX_LATENCY_MIN:
+            value = (rxLatency.count == 0) ? 0 : rxLatency.min;
+            break;
+        case DIAG_RX_LATENCY_MAX:
+            value = rxLatency.max;
+            break;
+        case DIAG_RX_LATENCY_AVG:
+            value = latencyAverage(&rxLatency);
+            break;
+        case DIAG_RX_LATENCY_COUNT:
+            value = rxLatency.count;
+            break;
+        case DIAG_EVENT_LOOKUP_MIN:
+            value = (eventLookup.count == 0) ? 0 : eventLookup.min;
+            break;
+        case DIAG_EVENT_LOOKUP_MAX:
+            value = eventLookup.max;
+            break;
+        case DIAG_EVENT_LOOKUP_AVG:
+            value = latencyAverage(&eventLookup);
+            break;
+        case DIAG_EVENT_LOOKUP_COUNT:
+            value = eventLookup.count;
+            break;
+        case DIAG_CAN_ERROR_STATE:
+            value = canErrorState;
+            break;
+        case DIAG_BUS_OFF_COUNT:
+            value = busOffCount;
+            break;
+        case DIAG_ERROR_PASSIVE_COUNT:
+            value = errorPassiveCount;
+            break;
+        case DIAG_BUS_OFF_RECOVERY_TIME:
+            value = busOffRecoveryTime;
+            break;
+        case DIAG_MAX_TX_ERROR_COUNT:
+            value = maxTxErrCount;
+            break;
+        case DIAG_TIME_TO_READY:
+            value = timeToReady;
+            break;
+#ifdef NV_CACHE
+        case DIAG_NV_ERASE_COUNT:
+            value = nvEraseCount;
+            break;
+#endif
+        case DIAG_OUR_SECTIONS:
+            value = (WORD)ourControlled;
+            break;
+        case DIAG_OTHER_SECTIONS:
+            value = (WORD)otherControlled;
+            break;
+#if NUM_SECTIONS > 16
+        case DIAG_OUR_SECTIONS_HIGH:
+            value = (WORD)(ourControlled >> 16);
+            break;
+        case DIAG_OTHER_SECTIONS_HIGH:
+            value = (WORD)(otherControlled >> 16);
+            break;
+#endif
+        case DIAG_OUR_SECTION_COUNT:
+            value = countOurControlled();
+            break;
+        case DIAG_LOOPBACK_RATE:
+        case DIAG_LOOPBACK_LATENCY_MIN:
+        case DIAG_LOOPBACK_LATENCY_MAX:
+        case DIAG_LOOPBACK_LATENCY_AVG:
+        case DIAG_LOOPBACK_FIFO_MAX:
+        case DIAG_LOOPBACK_LOST:
+            value = ee_read_short(EE_LOOPBACK_RESULTS + 2*(msg[d4] - DIAG_LOOPBACK_RATE));
+            break;
+        case DIAG_LEASES_EXPIRED:
+            value = leasesExpired;
+            break;
+        case DIAG_TAKE_TIES:
+            value = takeTies;
+            break;
+        case DIAG_ACK_FAILURES:
+            value = ackFailures;
+            break;
+        case DIAG_SYNC_MASTER:
+            value = syncMaster;
+            break;
+        case DIAG_SYNC_FAILOVERS:
+            value = syncFailovers;
+            break;
+        case DIAG_SYNC_FAILOVER_TIME:
+            value = syncFailoverTime;
+            break;
+        case DIAG_NOISE_REST_PEAK:
+        case DIAG_NOISE_REST_VARIANCE:
+        case DIAG_NOISE_REST_MEAN:
+        case DIAG_NOISE_SWEEP_PEAK:
+            value = ee_read_short(EE_NOISE_RESULTS + 2*(msg[d4] - DIAG_NOISE_REST_PEAK));
+            break;
+        default:
+            value = 0;
+            break;
+    }
+    cbusMsg[d3] = msg[d3];
+    cbusMsg[d4] = msg[d4];
+    cbusMsg[d5] = value >> 8;
+    cbusMsg[d6] = value & 0xFF;
+    cbusSendOpcMyNN(0, OPC_DGN, cbusMsg);
+}
@@ -0,0 +1,95 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   diagnostics.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef DIAGNOSTICS_H
+#define	DIAGNOSTICS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Diagnostic values are requested with RDGN <NN> <service> <code> and are
+ * returned with DGN <NN> <service> <code> <value hi> <value lo>.
+ */
+#ifndef OPC_RDGN
+#define OPC_RDGN    0x87
+#endif
+#ifndef OPC_DGN
+#define OPC_DGN     0xC7
+#endif
+
+// Diagnostic codes. Times are in CAN timestamp ticks unless stated otherwise.
+#define DIAG_RX_LATENCY_MIN         1
+#define DIAG_RX_LATENCY_MAX         2
+#define DIAG_RX_LATENCY_AVG         3
+#define DIAG_RX_LATENCY_COUNT       4
+#define DIAG_CAN_ERROR_STATE        5
+#define DIAG_BUS_OFF_COUNT          6
+#define DIAG_ERROR_PASSIVE_COUNT    7
+#define DIAG_BUS_OFF_RECOVERY_TIME  8   // ms
+#define DIAG_MAX_TX_ERROR_COUNT     9
+#define DIAG_TIME_TO_READY          10  // ms
+#define DIAG_NV_ERASE_COUNT         11
+#define DIAG_OUR_SECTIONS           12  // bitmap
+#define DIAG_OTHER_SECTIONS         13  // bitmap
+#define DIAG_OUR_SECTION_COUNT      14
+#define DIAG_OUR_SECTIONS_HIGH      15  // bitmap of sections 31-16
+#define DIAG_OTHER_SECTIONS_HIGH    16  // bitmap of sections 31-16
+#define DIAG_EVENT_LOOKUP_MIN       17
+#define DIAG_EVENT_LOOKUP_MAX       18
+#define DIAG_EVENT_LOOKUP_AVG       19
+#define DIAG_EVENT_LOOKUP_COUNT     20
+#define DIAG_LOOPBACK_RATE          21  // results of the last CAN loopback test, see tests.h
+#define DIAG_LOOPBACK_LATENCY_MIN   22
+#define DIAG_LOOPBACK_LATENCY_MAX   23
+#define DIAG_LOOPBACK_LATENCY_AVG   24
+#define DIAG_LOOPBACK_FIFO_MAX      25
+#define DIAG_LOOPBACK_LOST          26
+#define DIAG_NOISE_REST_PEAK        27  // results of the last pot noise test, see tests.h
+#define DIAG_NOISE_REST_VARIANCE    28
+#define DIAG_NOISE_REST_MEAN        29
+#define DIAG_NOISE_SWEEP_PEAK       30
+#define DIAG_LEASES_EXPIRED         31
+#define DIAG_TAKE_TIES              32
+#define DIAG_ACK_FAILURES           33
+#define DIAG_SYNC_MASTER            34  // CANID of the panel sending sync
+#define DIAG_SYNC_FAILOVERS         35
+#define DIAG_SYNC_FAILOVER_TIME     36
+
+extern void processDiagnosticRequest(BYTE * msg);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* DIAGNOSTICS_H */
+
@@ -0,0 +1,343 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   cbuslib.c
+ * Author: Ian
+ *
+ * Host build stand-ins for the parts of the CBUS library the firmware uses.
+ * They are simple versions of the library routines, enough for panels to run
+ * and talk to each other: sending and receiving messages, the event table 
+ * lookup, NV reads and writes over CBUS, the tick, program memory and EEPROM.
+ * FLiM setup, learning events and the status LEDs are not provided.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <string.h>
+#include "devincs.h"
+#include "module.h"
+#include "cbus.h"
+#include "romops.h"
+#include "EEPROM.h"
+#include "TickTime.h"
+#include "StatusLeds.h"
+#include "nvCache.h"
+#include "hal.h"
+#include "replay.h"
+
+BYTE cbusMsg[sizeof(CanPacket)];
+BYTE flimState;
+WORD nodeID;
+BYTE clkMHz;
+Event producedEvent;
+EventTable * eventTable = (EventTable *)(halFlash + AT_EVENTS);
+const BYTE * NvBytePtr = halFlash + AT_NV;
+
+extern void cabdcNvInit(void);
+extern void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char value);
+
+/*
+ * TickTime
+ */
+void initTicker(BYTE priority) {
+}
+
+void tickISR(void) {
+}
+
+DWORD tickGet(void) {
+    halService();
+    return (DWORD)(halNowNs() / 16000);
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return tickGet() - t.Val;
+}
+
+/*
+ * Program memory. Writes go straight to the array.
+ */
+void initRomOps(void) {
+}
+
+BYTE readFlashBlock(WORD flashAddr) {
+    return halFlash[flashAddr % HAL_FLASH_SIZE];
+}
+
+void writeFlashByte(BYTE * flashAddr, BYTE flashData) {
+    halFlash[(uintptr_t)flashAddr % HAL_FLASH_SIZE] = flashData;
+    halStateChanged = TRUE;
+}
+
+void flushFlashImage(void) {
+}
+
+/*
+ * NVs as the library has them, straight from and to program memory. With 
+ * NV_CACHE the firmware uses its cache instead and answers NVSET and NVRD
+ * itself before parseCBUSMsg() sees them.
+ */
+unsigned int getNodeVar(unsigned int index) {
+    return NvBytePtr[index];
+}
+
+void setNodeVar(unsigned int index, unsigned int value) {
+    writeFlashByte((BYTE*)AT_NV + index, (BYTE)value);
+    flushFlashImage();
+}
+
+/*
+ * EEPROM
+ */
+BYTE ee_read(WORD addr) {
+    return halEeprom[addr % HAL_EEPROM_SIZE];
+}
+
+void ee_write(WORD addr, BYTE data) {
+    halEeprom[addr % HAL_EEPROM_SIZE] = data;
+    halStateChanged = TRUE;
+}
+
+WORD ee_read_short(WORD addr) {
+    return ee_read(addr) | ((WORD)ee_read(addr + 1) << 8);
+}
+
+void ee_write_short(WORD addr, WORD data) {
+    ee_write(addr, (BYTE)data);
+    ee_write(addr + 1, (BYTE)(data >> 8));
+}
+
+/*
+ * Status LEDs
+ */
+void initStatusLeds(void) {
+}
+
+void startFLiMFlash(BOOL fast) {
+}
+
+void checkFlashing(void) {
+}
+
+void shortFlicker(void) {
+}
+
+void longFlicker(void) {
+}
+
+/*
+ * FLiM. The node number and CANID from the command line stand in for the
+ * module having been set up by the FCU.
+ */
+void flimInit(void) {
+    if (halOptions.nodeNumber != 0) {
+        ee_write_short((WORD)EE_NODE_ID, halOptions.nodeNumber);
+        ee_write((WORD)EE_FLIM_MODE, fsFLiM);
+    }
+    if (halOptions.canId != 0) {
+        ee_write((WORD)EE_CAN_ID, halOptions.canId);
+    }
+    flimState = ee_read((WORD)EE_FLIM_MODE);
+    nodeID = ee_read_short((WORD)EE_NODE_ID);
+    canInit(CBUS_OVER_CAN, 0);
+}
+
+// Called by the main loop straight after checkCBUS()
+void FLiMSWCheck(void) {
+    if (halOptions.replayFile) replayFrameEnd();
+}
+
+// cabdcFLiM.c holds the PIC parameter block so is not built for the host
+void cabdcFlimInit(void) {
+    flimInit();
+    cabdcNvInit();
+}
+
+/*
+ * Events
+ */
+void clearAllEvents(void) {
+    memset(eventTable, 0xFF, sizeof(EventTable) * NUM_EVENTS);
+    halStateChanged = TRUE;
+}
+
+static BYTE findEvent(WORD nodeNumber, WORD eventNumber) {
+    BYTE i;
+
+    for (i=0; i<NUM_EVENTS; i++) {
+        if ((eventTable[i].event_flags != 0xFF) 
+                && (eventTable[i].event.NN == nodeNumber) && (eventTable[i].event.EN == eventNumber)) {
+            return i;
+        }
+    }
+    return NUM_EVENTS;
+}
+
+BYTE addEvent(WORD nodeNumber, WORD eventNumber, BYTE evNum, BYTE evVal, BOOL forceOwnNN) {
+    BYTE i;
+
+    if (forceOwnNN) {
+        nodeNumber = nodeID;
+    }
+    i = findEvent(nodeNumber, eventNumber);
+    if (i == NUM_EVENTS) {
+        for (i=0; (i<NUM_EVENTS) && (eventTable[i].event_flags != 0xFF); i++)
+            ;
+        if (i == NUM_EVENTS) {
+            return CMDERR_TOO_MANY_EVENTS;
+        }
+        memset(&eventTable[i], 0, sizeof(EventTable));
+        eventTable[i].event.NN = nodeNumber;
+        eventTable[i].event.EN = eventNumber;
+    }
+    if (evNum < EVENT_TABLE_WIDTH) {
+        eventTable[i].evs[evNum] = evVal;
+    }
+    halStateChanged = TRUE;
+    return 0;
+}
+
+// The first EV of an event says which happening produces it
+BOOL getProducedEvent(HAPPENING_T happening) {
+    BYTE i;
+
+    for (i=0; i<NUM_EVENTS; i++) {
+        if ((eventTable[i].event_flags != 0xFF) && (eventTable[i].evs[0] == happening)) {
+            producedEvent = eventTable[i].event;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL sendProducedEvent(HAPPENING_T happening, BOOL on) {
+    if ( ! getProducedEvent(happening)) return FALSE;
+    return cbusSendEventWithData(CBUS_OVER_CAN, producedEvent.NN, producedEvent.EN, on, cbusMsg, 0);
+}
+
+/*
+ * Sending and receiving
+ */
+BOOL cbusMsgReceived(BYTE busNum, BYTE *msg) {
+    if (halOptions.replayFile == NULL) return canbusRecv((CanPacket *)msg);
+    replaySwitches();
+    if ( ! canbusRecv((CanPacket *)msg)) return FALSE;
+    replayFrameStart(msg);
+    return TRUE;
+}
+
+// The length of a message is given by the top 3 bits of the opcode
+BOOL cbusSendMsg(BYTE busNum, BYTE *msg) {
+    return canSend(msg, (msg[d0] >> 5) + 1);
+}
+
+BOOL cbusSendOpcNN(BYTE busNum, BYTE opc, WORD nodeNumber, BYTE *msg) {
+    msg[d0] = opc;
+    msg[d1] = nodeNumber >> 8;
+    msg[d2] = nodeNumber & 0xFF;
+    return cbusSendMsg(busNum, msg);
+}
+
+BOOL cbusSendOpcMyNN(BYTE busNum, BYTE opc, BYTE *msg) {
+    return cbusSendOpcNN(busNum, opc, nodeID, msg);
+}
+
+// A node number of 0 sends a short event with our own node number
+BOOL cbusSendEventWithData(BYTE busNum, WORD nodeNumber, WORD eventNumber, BOOL onEvent, BYTE *msg, BYTE datalen) {
+    BYTE opc;
+
+    opc = OPC_ACON + (datalen << 5);
+    if (nodeNumber == 0) {
+        opc |= 0x08;
+        nodeNumber = nodeID;
+    }
+    if ( ! onEvent) {
+        opc |= 0x01;
+    }
+    msg[d3] = eventNumber >> 8;
+    msg[d4] = eventNumber & 0xFF;
+    return cbusSendOpcNN(busNum, opc, nodeNumber, msg);
+}
+
+BOOL thisNN(BYTE *msg) {
+    return (msg[d1] == (nodeID >> 8)) && (msg[d2] == (nodeID & 0xFF));
+}
+
+void doError(unsigned int code) {
+    cbusMsg[d3] = code;
+    cbusSendOpcMyNN(CBUS_OVER_CAN, OPC_CMDERR, cbusMsg);
+}
+
+void arraySetBit(BYTE * array, BYTE bitNum) {
+    array[bitNum >> 3] |= 1 << (bitNum & 7);
+}
+
+static void parseNvRequest(BYTE *msg) {
+    BYTE index;
+    BYTE old;
+
+    index = msg[d3];
+    if ((index == 0) || (index >= NV_NUM)) {
+        doError(CMDERR_INV_NV_IDX);
+        return;
+    }
+    if (msg[d0] == OPC_NVSET) {
+        old = (BYTE)getNodeVar(index);
+        if ( ! validateNV(index, old, msg[d4])) {
+            doError(CMDERR_INV_NV_VALUE);
+            return;
+        }
+        setNodeVar(index, msg[d4]);
+        actUponNVchange(index, old, msg[d4]);
+        cbusSendOpcMyNN(CBUS_OVER_CAN, OPC_WRACK, cbusMsg);
+    } else {
+        cbusMsg[d3] = index;
+        cbusMsg[d4] = (BYTE)getNodeVar(index);
+        cbusSendOpcMyNN(CBUS_OVER_CAN, OPC_NVANS, cbusMsg);
+    }
+}
+
+/**
+ * Act upon the messages the library handles: events in the event table and
+ * NV reads and writes. Short events are looked up with a node number of 0.
+ * @return TRUE if the message was handled
+ */
+BOOL parseCBUSMsg(BYTE *msg) {
+    BYTE opc;
+    BYTE i;
+    WORD nodeNumber;
+
+    opc = msg[d0];
+    if (((opc & 0x90) == 0x90) && ((opc & 0x06) == 0)) {
+        nodeNumber = (opc & 0x08) ? 0 : ((WORD)msg[d1] << 8) | msg[d2];
+        i = findEvent(nodeNumber, ((WORD)msg[d3] << 8) | msg[d4]);
+        if (i == NUM_EVENTS) return FALSE;
+        processEvent(i, msg);
+        return TRUE;
+    }
+    if (((opc == OPC_NVSET) || (opc == OPC_NVRD)) && thisNN(msg) && (flimState != fsSLiM)) {
+        parseNvRequest(msg);
+        return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,623 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   hal.c
+ * Author: Ian
+ *
+ * Emulation of the PIC peripherals for the host build. See hal.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "devincs.h"
+#include "can18.h"
+#include "TickTime.h"
+#include "hal.h"
+#include "vcan.h"
+#include "sim.h"
+#include "replay.h"
+
+/*
+ * The special function registers. Those behind an accessor are static here.
+ */
+volatile HostCanBuffer hostTxBuffer[HOST_TX_BUFFERS];
+volatile HostCanBuffer hostRxBuffer[HOST_RX_BUFFERS];
+
+volatile BYTE ECANCON, BSEL0, BRGCON1, BRGCON2, BRGCON3, CIOCON, BIE0, TXBIE;
+volatile BYTE TXERRCNT, RXERRCNT;
+volatile BYTE RXM0SIDH, RXM0SIDL, RXM0EIDH, RXM0EIDL, RXM1SIDH, RXM1SIDL, RXM1EIDH, RXM1EIDL;
+volatile BYTE RXF0SIDL, RXFBCON0, RXFBCON1, RXFBCON2, RXFBCON3, RXFBCON4, RXFBCON5, RXFBCON6, RXFBCON7;
+volatile BYTE MSEL0, MSEL1, MSEL2, MSEL3;
+volatile BYTE PIR1, PIR3, PIE3, IPR3, PIR5, PIE5, IPR5, RCON, INTCON, INTCON2;
+volatile BYTE TMR1H, T1CON, CCP1CON, CCPR1L, CCPR1H, CCPTMRS;
+volatile BYTE ADCON1, ADCON2, ADRESH, ADRESL, ANCON0, ANCON1;
+volatile BYTE PORTA, PORTB, PORTC, LATA, LATB, LATC, TRISA, TRISB, TRISC, WPUB;
+volatile BYTE SSPBUF, SSPCON1, SSPSTAT, OSCTUNE;
+
+static BYTE cancon;
+static BYTE canstat;
+static BYTE comstat;
+static BYTE tmr1l;
+static BYTE adcon0;
+
+#define CAN_MODE_MASK       0xE0
+#define CAN_MODE_NORMAL     0x00
+#define CAN_MODE_CONFIG     0x80
+
+/*
+ * Memories.
+ */
+BYTE halFlash[HAL_FLASH_SIZE];
+BYTE halEeprom[HAL_EEPROM_SIZE];
+BOOL halStateChanged;
+
+HalOptions halOptions;
+HalStats halStats;
+
+/*
+ * Board IO.
+ */
+BYTE halSwitches[8 * NUM_MATRICES];
+BYTE halLedsShown[4 * NUM_MATRICES];
+BYTE halPot = 128;
+static BYTE switchRow;
+static BYTE cathodesShifted[NUM_MATRICES];
+static BYTE cathodesLatched[NUM_MATRICES];
+
+/*
+ * ECAN state.
+ */
+static BYTE rxRead;                 // FIFO read pointer, the buffer the firmware reads next
+static BYTE rxWrite;                // the buffer the next received frame goes in
+static signed char txSending;       // transmit buffer whose frame is on the bus, -1 if none
+static VcanFrame txFrame;           // the frame being sent
+static uint64_t busFreeNs;          // when the frame being sent is finished
+
+static BOOL inInterrupt;
+static BOOL inService;
+static uint64_t lastInterruptNs;
+static uint64_t lastPollNs;
+static uint64_t lastSaveNs;
+
+#define TIMER_INTERRUPT_NS      4096000ULL  // TMR0 overflows, so the interrupt routine runs at least this often
+#define IDLE_WAIT_US            100
+#define POLL_NS                 10000000ULL
+#define SAVE_NS                 100000000ULL
+
+static char ** savedArgv;
+
+/*
+ * Under the layout simulator.
+ */
+static uint64_t simNs;              // the simulated clock
+static uint64_t simUntilNs;         // end of the run the simulator allowed
+static uint64_t txRequestNs[HOST_TX_BUFFERS];   // when each buffer's TXREQ was first seen, 0 if clear
+static BOOL simClock;               // under the simulator or replaying a trace
+
+uint64_t halNowNs(void) {
+    struct timespec ts;
+
+    if (simClock) return simNs;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Register accessors.
+ */
+
+static BYTE rxFullCount(void) {
+    BYTE i;
+    BYTE count = 0;
+
+    for (i=0; i<HOST_RX_BUFFERS; i++) {
+        if (hostRxBuffer[i].con & RXFUL) count++;
+    }
+    return count;
+}
+
+// The read pointer moves on once the firmware has emptied the buffer it points to
+static void updateRxFifo(void) {
+    BYTE full;
+
+    full = rxFullCount();
+    while ((full > 0) && !(hostRxBuffer[rxRead].con & RXFUL)) {
+        rxRead = (rxRead + 1) % HOST_RX_BUFFERS;
+    }
+    if (full) {
+        comstat |= 0x80;            // NOT_FIFOEMPTY
+    } else {
+        comstat &= ~0x80;
+    }
+}
+
+volatile BYTE * hostCANCON(void) {
+    updateRxFifo();
+    cancon = (cancon & CAN_MODE_MASK) | rxRead;
+    return &cancon;
+}
+
+// The requested mode is entered straight away. Configuration mode resets the error state.
+volatile BYTE * hostCANSTAT(void) {
+    canstat = (canstat & ~CAN_MODE_MASK) | (cancon & CAN_MODE_MASK);
+    if ((cancon & CAN_MODE_MASK) == CAN_MODE_CONFIG) {
+        comstat &= 0xC0;
+        TXERRCNT = 0;
+        RXERRCNT = 0;
+    }
+    return &canstat;
+}
+
+volatile BYTE * hostCOMSTAT(void) {
+    updateRxFifo();
+    return &comstat;
+}
+
+// TMR1 counts Fosc/4 with a 1:8 prescaler, 2us at 16MHz
+volatile BYTE * hostTMR1L(void) {
+    WORD t;
+
+    t = (WORD)(halNowNs() / 2000);
+    tmr1l = (BYTE)t;
+    TMR1H = (BYTE)(t >> 8);
+    return &tmr1l;
+}
+
+volatile BYTE * hostADCON0(void) {
+    if (adcon0 & 0x02) {           // GO
+        ADRESH = halPot;
+        ADRESL = 0;
+        adcon0 &= ~0x02;
+    }
+    return &adcon0;
+}
+
+/*
+ * ECAN.
+ */
+
+static void receiveFrame(VcanFrame * frame, uint64_t now) {
+    volatile HostCanBuffer * b;
+    WORD capture;
+    BYTE free;
+
+    if ((cancon & CAN_MODE_MASK) != CAN_MODE_NORMAL) return;
+    updateRxFifo();
+    if (rxFullCount() == HOST_RX_BUFFERS) {
+        comstat |= 0x40;            // RXBnOVFL
+        halStats.rxOverflows++;
+        return;
+    }
+    b = &hostRxBuffer[rxWrite];
+    b->sidh = frame->sidh;
+    b->sidl = frame->sidl;
+    b->eidh = 0;
+    b->eidl = 0;
+    b->dlc = frame->dlc;
+    memcpy((void *)b->d, frame->d, 8);
+    b->con |= RXFUL;
+    rxWrite = (rxWrite + 1) % HOST_RX_BUFFERS;
+    updateRxFifo();
+
+    // CCP1 captured TMR1 at the start of frame
+    capture = (WORD)(frame->sofNs / 2000);
+    CCPR1L = (BYTE)capture;
+    CCPR1H = (BYTE)(capture >> 8);
+    PIR3bits.CCP1IF = 1;
+
+    RXBnIF = 1;
+    free = HOST_RX_BUFFERS - rxFullCount();
+    if (free <= ((ECANCON & 0x20) ? 1 : 4)) {
+        FIFOWMIF = 1;
+    }
+
+    halStats.rxFrames++;
+    if (now > frame->eofNs) {
+        halStats.transitNsTotal += now - frame->eofNs;
+        if (now - frame->eofNs > halStats.transitNsMax) {
+            halStats.transitNsMax = now - frame->eofNs;
+        }
+    }
+}
+
+/**
+ * Receive a frame from another module.
+ * @param canId the CANID of the sender
+ * @param data the opcode and data bytes
+ * @param len the number of bytes, HAL_RTR for an enumeration request
+ */
+void halReceive(BYTE canId, BYTE * data, BYTE len) {
+    VcanFrame frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.sofNs = halNowNs();
+    frame.eofNs = frame.sofNs;
+    frame.sidh = 0b10110000 | ((canId & 0x78) >> 3);
+    frame.sidl = (canId & 0x07) << 5;
+    if (len == HAL_RTR) {
+        frame.dlc = 0x40;
+    } else {
+        frame.dlc = (len > 8) ? 8 : len;
+        memcpy(frame.d, data, frame.dlc);
+    }
+    receiveFrame(&frame, frame.sofNs);
+}
+
+/**
+ * Receive a frame as though another module had sent it.
+ * @param data the opcode and data bytes
+ * @param len the number of bytes
+ */
+void halInjectFrame(BYTE * data, BYTE len) {
+    halReceive(HAL_CONSOLE_CANID, data, len);
+}
+
+// The highest priority transmit buffer with TXREQ set, -1 if none
+static signed char nextTxBuffer(void) {
+    signed char i;
+    signed char best = -1;
+
+    for (i=HOST_TX_BUFFERS-1; i>=0; i--) {
+        if ((hostTxBuffer[i].con & 0x08)
+                && ((best < 0) || ((hostTxBuffer[i].con & 0x03) > (hostTxBuffer[best].con & 0x03)))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// The frame in transmit buffer i has gone
+static void transmitDone(BYTE i) {
+    volatile HostCanBuffer * b;
+
+    halStats.txFrames++;
+    b = &hostTxBuffer[i];
+    b->con &= ~0x08;                // TXREQ
+    txRequestNs[i] = 0;
+    if (TXBIE & (0x04 << i)) {
+        b->con |= 0x80;             // TXBIF
+        TXBnIF = 1;
+    }
+}
+
+static void serviceTransmit(uint64_t now) {
+    volatile HostCanBuffer * b;
+
+    if (now < busFreeNs) return;
+    if (txSending >= 0) {
+        if (halOptions.replayFile) {
+            replayFrameSent(&txFrame);
+        } else {
+            vcanSend(&txFrame);
+        }
+        transmitDone(txSending);
+        txSending = -1;
+    }
+    if ((cancon & CAN_MODE_MASK) != CAN_MODE_NORMAL) return;
+    txSending = nextTxBuffer();
+    if (txSending >= 0) {
+        b = &hostTxBuffer[txSending];
+        txFrame.sofNs = now;
+        txFrame.sidh = b->sidh;
+        txFrame.sidl = b->sidl;
+        txFrame.dlc = b->dlc;
+        memcpy(txFrame.d, (void *)b->d, 8);
+        busFreeNs = now + HAL_CAN_FRAME_BITS((b->dlc & 0x40) ? 0 : (b->dlc & 0x0F)) * HAL_CAN_BIT_NS;
+        txFrame.eofNs = busFreeNs;
+        halStats.busNs += busFreeNs - now;
+    }
+}
+
+// Nothing for the CAN driver to do until a frame arrives
+extern BYTE rxIndexNextFree;
+extern BYTE rxIndexNextUsed;
+
+static BOOL canIdle(void) {
+    return (txSending < 0) && (nextTxBuffer() < 0) && (rxFullCount() == 0)
+            && (rxIndexNextFree == rxIndexNextUsed);
+}
+
+/*
+ * Interrupts. The routine is the same as ISRLow() in main.c.
+ */
+
+static BOOL interruptPending(void) {
+    return (PIR3bits.CCP1IF && PIE3bits.CCP1IE)
+            || (FIFOWMIF && FIFOWMIE)
+            || (ERRIF && ERRIE)
+            || (TXBnIF && TXBnIE);
+}
+
+static void runInterrupt(uint64_t now) {
+    if (inInterrupt || !INTCONbits.GIEL) return;
+    if (!interruptPending() && (now - lastInterruptNs < TIMER_INTERRUPT_NS)) return;
+    inInterrupt = TRUE;
+    halStats.isrCalls++;
+    tickISR();
+    canInterruptHandler();
+    lastInterruptNs = now;
+    inInterrupt = FALSE;
+}
+
+/*
+ * The layout simulator, see sim.h.
+ */
+
+static BYTE fifoCount(BYTE nextFree, BYTE nextUsed, BYTE len) {
+    if (nextFree == 0xFF) return len;
+    return (nextFree >= nextUsed) ? nextFree - nextUsed : nextFree + len - nextUsed;
+}
+
+extern BYTE txIndexNextFree;
+extern BYTE txIndexNextUsed;
+
+// Tell the simulator where we are and carry out what it sends until it lets us run on
+static void simSync(void) {
+    SimMsg msg;
+    signed char i;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SIM_REPORT;
+    i = nextTxBuffer();
+    if ((i >= 0) && ((cancon & CAN_MODE_MASK) == CAN_MODE_NORMAL)) {
+        msg.pending = TRUE;
+        msg.txBuffer = i;
+        msg.ns = txRequestNs[i];
+        msg.frame.sidh = hostTxBuffer[i].sidh;
+        msg.frame.sidl = hostTxBuffer[i].sidl;
+        msg.frame.dlc = hostTxBuffer[i].dlc;
+        memcpy(msg.frame.d, (void *)hostTxBuffer[i].d, 8);
+    }
+    msg.txQueue = fifoCount(txIndexNextFree, txIndexNextUsed, CANTX_FIFO_LEN);
+    msg.rxQueue = fifoCount(rxIndexNextFree, rxIndexNextUsed, CANRX_FIFO_LEN);
+    msg.rxHardware = rxFullCount();
+    msg.rxOverflows = halStats.rxOverflows;
+    if (send(halOptions.simFd, &msg, sizeof(msg), 0) != sizeof(msg)) exit(1);
+
+    for (;;) {
+        if (recv(halOptions.simFd, &msg, sizeof(msg), 0) != sizeof(msg)) exit(1);
+        switch (msg.type) {
+            case SIM_RUN:
+                // after a reset the clock starts again from where the simulator is
+                if (simNs < msg.ns) simNs = msg.ns;
+                simUntilNs = msg.untilNs;
+                return;
+            case SIM_FRAME:
+                receiveFrame(&msg.frame, simNs);
+                runInterrupt(simNs);
+                break;
+            case SIM_TX_DONE:
+                transmitDone(msg.txBuffer);
+                break;
+            case SIM_COMMAND:
+                msg.text[SIM_TEXT_LEN-1] = '\0';
+                hostCommand(msg.text);
+                break;
+            case SIM_QUIT:
+                fflush(stdout);
+                exit(0);
+        }
+    }
+}
+
+static void simService(void) {
+    BYTE i;
+
+    simNs += halOptions.loopNs;
+    for (i=0; i<HOST_TX_BUFFERS; i++) {
+        if ((hostTxBuffer[i].con & 0x08) && (txRequestNs[i] == 0)) {
+            txRequestNs[i] = simNs;
+        }
+    }
+    if (simNs >= simUntilNs) {
+        simSync();
+    }
+    runInterrupt(simNs);
+    if (simNs - lastPollNs > POLL_NS) {
+        lastPollNs = simNs;
+        hostPoll();
+    }
+}
+
+static void replayHalService(void) {
+    simNs += halOptions.loopNs;
+    serviceTransmit(simNs);
+    replayService(simNs);
+    runInterrupt(simNs);
+    if (simNs - lastPollNs > POLL_NS) {
+        lastPollNs = simNs;
+        hostPoll();
+    }
+}
+
+/**
+ * Let the hardware run. Called from tickGet().
+ */
+void halService(void) {
+    VcanFrame frame;
+    uint64_t now;
+
+    if (inInterrupt || inService) return;
+    inService = TRUE;
+    if (halOptions.simFd >= 0) {
+        simService();
+        inService = FALSE;
+        return;
+    }
+    if (halOptions.replayFile) {
+        replayHalService();
+        inService = FALSE;
+        return;
+    }
+    if ( ! halOptions.spin && canIdle()) {
+        vcanWait(IDLE_WAIT_US);
+    }
+    now = halNowNs();
+    serviceTransmit(now);
+    // A frame at a time so the interrupt routine takes each capture before the next
+    while (vcanReceive(&frame)) {
+        receiveFrame(&frame, now);
+        runInterrupt(now);
+    }
+    runInterrupt(now);
+    if (now - lastPollNs > POLL_NS) {
+        lastPollNs = now;
+        hostPoll();
+    }
+    if (halStateChanged && (now - lastSaveNs > SAVE_NS)) {
+        lastSaveNs = now;
+        halSaveState();
+    }
+    inService = FALSE;
+}
+
+/*
+ * Program memory and EEPROM persistence.
+ */
+
+static void loadState(void) {
+    FILE * f;
+
+    if (halOptions.stateFile == NULL) return;
+    f = fopen(halOptions.stateFile, "rb");
+    if (f == NULL) return;
+    if ((fread(halFlash, 1, HAL_FLASH_SIZE, f) != HAL_FLASH_SIZE)
+            || (fread(halEeprom, 1, HAL_EEPROM_SIZE, f) != HAL_EEPROM_SIZE)) {
+        fprintf(stderr, "%s is not a saved state, starting blank\n", halOptions.stateFile);
+        memset(halFlash, 0xFF, HAL_FLASH_SIZE);
+        memset(halEeprom, 0xFF, HAL_EEPROM_SIZE);
+    }
+    fclose(f);
+}
+
+void halSaveState(void) {
+    FILE * f;
+
+    halStateChanged = FALSE;
+    if (halOptions.stateFile == NULL) return;
+    f = fopen(halOptions.stateFile, "wb");
+    if (f == NULL) {
+        perror(halOptions.stateFile);
+        return;
+    }
+    fwrite(halFlash, 1, HAL_FLASH_SIZE, f);
+    fwrite(halEeprom, 1, HAL_EEPROM_SIZE, f);
+    fclose(f);
+}
+
+/**
+ * Power up. halOptions must have been filled in.
+ * @param argc
+ * @param argv the command line, kept so that a reset can restart the process
+ */
+void halInit(int argc, char ** argv) {
+    savedArgv = argv;
+    memset(halFlash, 0xFF, HAL_FLASH_SIZE);
+    memset(halEeprom, 0xFF, HAL_EEPROM_SIZE);
+    loadState();
+
+    PORTA = 0x08;                   // PB released
+    cancon = CAN_MODE_CONFIG;
+    txSending = -1;
+    simClock = (halOptions.simFd >= 0) || (halOptions.replayFile != NULL);
+    lastInterruptNs = halNowNs();
+    if (halOptions.replayFile) {
+        replayOpen(halOptions.replayFile, halOptions.replayOffsetMs);
+    }
+    if (simClock) return;
+    if ( ! vcanOpen(halOptions.node, halOptions.nodes, halOptions.basePort)) {
+        exit(1);
+    }
+}
+
+/**
+ * A software reset restarts the process, keeping the program memory and 
+ * EEPROM if there is a state file.
+ */
+void hostReset(void) {
+    halSaveState();
+    fflush(stdout);
+    execv("/proc/self/exe", savedArgv);
+    perror("reset");
+    exit(1);
+}
+
+/*
+ * Board IO.
+ */
+
+// Switch sw is row sw%8, column (sw/8)%4 of matrix sw/32 as in getSwitchState()
+void halSetSwitch(BYTE sw, BOOL on) {
+    BYTE row;
+    BYTE bit;
+
+    if (sw >= 32 * NUM_MATRICES) return;
+    row = (sw/32)*8 + (sw & 7);
+    bit = 1 << ((sw/8) & 3);
+    if (on) {
+        halSwitches[row] |= bit;
+    } else {
+        halSwitches[row] &= ~bit;
+    }
+}
+
+void halSelectSwitchRow(BYTE row) {
+    switchRow = row & 7;
+}
+
+BYTE halReadSwitchColumns(BYTE matrix) {
+    return halSwitches[matrix*8 + switchRow] & 0x0f;
+}
+
+// The cathode drivers are chained, each byte sent pushes the others along
+void halSendLedCathodes(BYTE cathodes) {
+    BYTE m;
+
+    for (m=NUM_MATRICES-1; m>0; m--) {
+        cathodesShifted[m] = cathodesShifted[m-1];
+    }
+    cathodesShifted[0] = cathodes;
+}
+
+void halLatchLeds(void) {
+    memcpy(cathodesLatched, cathodesShifted, NUM_MATRICES);
+}
+
+void halSelectLedAnodes(BYTE row) {
+    BYTE m;
+
+    for (m=0; m<NUM_MATRICES; m++) {
+        halLedsShown[4*m + row] = cathodesLatched[m];
+    }
+}
+
+// LED no is numbered as for setLed()
+BOOL halLedLit(BYTE no) {
+    return (halLedsShown[no/8] & (1 << (no%8))) != 0;
+}
@@ -0,0 +1,140 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   hal.h
+ * Author: Ian
+ *
+ * Hardware emulation for the host build of the firmware. 
+ * 
+ * hal.c stands in for the PIC peripherals the firmware uses: the ECAN with its
+ * 8 buffer receive FIFO and 3 transmit buffers, TMR1 and the CCP1 start of 
+ * frame capture, the ADC, the program memory and EEPROM and, through 
+ * hostboard.h, the switch and LED matrices. It is driven from tickGet(), which
+ * the firmware calls continually, so the peripherals are serviced and the 
+ * interrupt routine is run between firmware statements much as on the module.
+ * Unless told to spin, the HAL sleeps for a short while waiting for a frame 
+ * when the firmware has nothing to do so that several panels can share a CPU.
+ *
+ * Under the layout simulator (see sim.h) the clock is simulated instead: each
+ * call of halService() moves it on by loopNs and the simulator, rather than
+ * the UDP bus, carries the frames. The clock is simulated in the same way when
+ * replaying a trace (see replay.h) and the frames come from the trace.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef HAL_H
+#define	HAL_H
+
+#include "GenericTypeDefs.h"
+#include "candccab.h"
+
+/*
+ * Program memory and EEPROM.
+ */
+#ifdef __18F26K80
+#define HAL_FLASH_SIZE      0x10000
+#else
+#define HAL_FLASH_SIZE      0x8000
+#endif
+#define HAL_EEPROM_SIZE     0x400
+
+extern BYTE halFlash[HAL_FLASH_SIZE];
+extern BYTE halEeprom[HAL_EEPROM_SIZE];
+extern BOOL halStateChanged;           // set when either is written, they are saved shortly after
+
+/*
+ * Options given on the command line.
+ */
+typedef struct {
+    BYTE node;              // our position on the virtual bus, 0 to nodes-1
+    BYTE nodes;             // number of panels on the virtual bus
+    WORD basePort;          // UDP port of node 0
+    WORD nodeNumber;        // CBUS node number to use, 0 to leave as saved
+    BYTE canId;             // CANID to use, 0 to leave as saved
+    const char * stateFile; // where to keep the program memory and EEPROM, NULL for none
+    BOOL spin;              // never sleep when idle, for the best timing when there is a CPU per panel
+    int simFd;              // socket to cabdc_sim, -1 when on the UDP bus
+    unsigned loopNs;        // simulated time between calls of tickGet() under cabdc_sim or replaying
+    const char * replayFile;    // trace to replay, NULL when not replaying
+    unsigned replayOffsetMs;    // when the trace starts after power up
+} HalOptions;
+
+extern HalOptions halOptions;
+
+/*
+ * CAN bus timing. Frames are paced at 125kbit/s with an allowance for
+ * bit stuffing so one panel cannot send faster than the real bus allows.
+ */
+#define HAL_CAN_BIT_NS          8000UL
+#define HAL_CAN_FRAME_BITS(len) (52 + 10*(len))     // 47 bit standard frame plus stuffing
+
+/*
+ * Counters for the throughput and latency report.
+ */
+typedef struct {
+    DWORD txFrames;
+    DWORD rxFrames;
+    DWORD rxOverflows;      // frames lost because all 8 hardware buffers were full
+    DWORD isrCalls;
+    uint64_t busNs;         // time the bus was busy with our frames
+    uint64_t transitNsTotal;    // end of frame at the sender to the frame being in our buffers
+    uint64_t transitNsMax;
+} HalStats;
+
+extern HalStats halStats;
+
+extern void halInit(int argc, char ** argv);
+extern void halService(void);
+extern uint64_t halNowNs(void);
+extern void halSaveState(void);
+#define HAL_RTR     0xFF        // halReceive() len for an RTR frame
+
+extern void halReceive(BYTE canId, BYTE * data, BYTE len);
+extern void halInjectFrame(BYTE * data, BYTE len);
+
+#define HAL_CONSOLE_CANID   0x7F    // the CANID frames typed at the console appear to come from
+
+/*
+ * Board IO, see hostboard.h. 
+ */
+extern BYTE halSwitches[8 * NUM_MATRICES];      // row m*8+r, bit c is column c
+extern BYTE halLedsShown[4 * NUM_MATRICES];     // the cathodes latched for each anode, as led_matrix
+extern BYTE halPot;
+
+extern void halSetSwitch(BYTE sw, BOOL on);
+extern void halSelectSwitchRow(BYTE row);
+extern BYTE halReadSwitchColumns(BYTE matrix);
+extern void halSendLedCathodes(BYTE cathodes);
+extern void halLatchLeds(void);
+extern void halSelectLedAnodes(BYTE row);
+extern BOOL halLedLit(BYTE no);
+
+/*
+ * Provided by hostmain.c. hostPoll() is called regularly from halService()
+ * and hostCommand() runs a console command given by the simulator.
+ */
+extern void hostPoll(void);
+extern void hostCommand(char * text);
+
+#endif	/* HAL_H */
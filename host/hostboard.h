@@ -0,0 +1,66 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   hostboard.h
+ * Author: Ian
+ *
+ * Board description of the host build. The panel has the CANPAN's section,
+ * switch and LED layout but the matrices are those emulated by hal.c.
+ * See board.h for what each macro does.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef HOSTBOARD_H
+#define	HOSTBOARD_H
+
+#include "hal.h"
+
+#define BOARD_READ_SWITCH_COLUMNS_1()   halReadSwitchColumns(1)
+
+#include "canpan.h"
+
+#undef BOARD_SWITCH_INIT
+#undef BOARD_SELECT_SWITCH_ROW
+#undef BOARD_READ_SWITCH_COLUMNS_0
+#undef BOARD_LED_INIT
+#undef BOARD_LED_DISABLE
+#undef BOARD_LED_ENABLE
+#undef BOARD_LED_SEND_CATHODES
+#undef BOARD_LED_LATCH
+#undef BOARD_LED_ANODES
+#undef BOARD_LED_SELECT_ANODES
+
+#define BOARD_SWITCH_INIT()
+#define BOARD_SELECT_SWITCH_ROW(r)      halSelectSwitchRow(r)
+#define BOARD_READ_SWITCH_COLUMNS_0()   halReadSwitchColumns(0)
+
+#define BOARD_LED_INIT()
+#define BOARD_LED_DISABLE()
+#define BOARD_LED_ENABLE()
+#define BOARD_LED_SEND_CATHODES(c)      halSendLedCathodes(c)
+#define BOARD_LED_LATCH()               halLatchLeds()
+#define BOARD_LED_ANODES(r)             (r)
+#define BOARD_LED_SELECT_ANODES(a)      halSelectLedAnodes(a)
+
+#endif	/* HOSTBOARD_H */
@@ -0,0 +1,288 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   hostmain.c
+ * Author: Ian
+ *
+ * Entry point of the host build. Takes the panel's options from the command
+ * line, powers up the emulated hardware and runs the firmware's main(). 
+ * Switches and the potentiometer are worked from commands typed on stdin and
+ * throughput and latency are reported on stdout. Under the layout simulator,
+ * cabdc_sim, the commands come from the simulator instead and with --replay
+ * they come from a trace, see replay.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "devincs.h"
+#include "module.h"
+#include "cbus.h"
+#include "sections.h"
+#include "latency.h"
+#include "hal.h"
+#include "replay.h"
+
+extern int firmwareMain(void);
+
+// CAN driver statistics from cabdccan18.c
+extern BYTE maxCanTxFifo;
+extern BYTE maxCanRxFifo;
+extern BYTE txOflowCount;
+extern BYTE rxOflowCount;
+
+#define PRESS_NS        100000000ULL    // how long a press holds a switch on
+#define SIM_LOOP_NS     10000           // default simulated time between tickGet() calls
+
+static unsigned statsPeriod;            // seconds between reports, 0 for none
+static uint64_t lastReportNs;
+static HalStats lastStats;
+static char line[80];
+static BYTE lineLength;
+static BOOL consoleOpen = TRUE;
+static int pressedSwitch = -1;
+static uint64_t releaseNs;
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [options]\n"
+            "  -n, --node N        position on the virtual bus, 0 to nodes-1 (0)\n"
+            "  -N, --nodes N       number of panels on the virtual bus (2)\n"
+            "  -p, --port P        UDP port of node 0 (41700)\n"
+            "  -a, --nn NN         node number, puts the panel in FLiM\n"
+            "  -c, --canid ID      CANID\n"
+            "  -f, --state FILE    keep program memory and EEPROM in FILE\n"
+            "  -s, --stats SECS    report throughput and latency every SECS seconds\n"
+            "  -S, --spin          never sleep when idle\n"
+            "      --sim FD        run under cabdc_sim, which is connected on FD\n"
+            "      --loop-ns NS    simulated time between tickGet() calls under cabdc_sim (%u)\n"
+            "      --replay FILE   replay a frame trace then exit, - for stdin\n"
+            "      --offset MS     start the trace MS after power up (%u)\n",
+            name, SIM_LOOP_NS, REPLAY_OFFSET_MS);
+    exit(2);
+}
+
+static void parseOptions(int argc, char ** argv) {
+    static const struct option options[] = {
+        { "node", required_argument, NULL, 'n' },
+        { "nodes", required_argument, NULL, 'N' },
+        { "port", required_argument, NULL, 'p' },
+        { "nn", required_argument, NULL, 'a' },
+        { "canid", required_argument, NULL, 'c' },
+        { "state", required_argument, NULL, 'f' },
+        { "stats", required_argument, NULL, 's' },
+        { "spin", no_argument, NULL, 'S' },
+        { "sim", required_argument, NULL, 'F' },
+        { "loop-ns", required_argument, NULL, 'L' },
+        { "replay", required_argument, NULL, 'R' },
+        { "offset", required_argument, NULL, 'O' },
+        { NULL, 0, NULL, 0 }
+    };
+    int c;
+
+    halOptions.node = 0;
+    halOptions.nodes = 2;
+    halOptions.basePort = 41700;
+    halOptions.simFd = -1;
+    halOptions.loopNs = SIM_LOOP_NS;
+    halOptions.replayOffsetMs = REPLAY_OFFSET_MS;
+    while ((c = getopt_long(argc, argv, "n:N:p:a:c:f:s:S", options, NULL)) != -1) {
+        switch (c) {
+            case 'n': halOptions.node = atoi(optarg); break;
+            case 'N': halOptions.nodes = atoi(optarg); break;
+            case 'p': halOptions.basePort = atoi(optarg); break;
+            case 'a': halOptions.nodeNumber = strtoul(optarg, NULL, 0); break;
+            case 'c': halOptions.canId = strtoul(optarg, NULL, 0); break;
+            case 'f': halOptions.stateFile = optarg; break;
+            case 's': statsPeriod = atoi(optarg); break;
+            case 'S': halOptions.spin = TRUE; break;
+            case 'F': halOptions.simFd = atoi(optarg); break;
+            case 'L': halOptions.loopNs = atoi(optarg); break;
+            case 'R': halOptions.replayFile = optarg; break;
+            case 'O': halOptions.replayOffsetMs = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if ((halOptions.node >= halOptions.nodes) || (halOptions.canId > 99) || (halOptions.loopNs == 0)) {
+        usage(argv[0]);
+    }
+}
+
+static void printUs(const char * name, LatencyStats * stats) {
+    if (stats->count == 0) {
+        printf(" %s -", name);
+    } else {
+        printf(" %s %u/%u/%uus", name, stats->min * CAN_TIMESTAMP_US, 
+                latencyAverage(stats) * CAN_TIMESTAMP_US, stats->max * CAN_TIMESTAMP_US);
+    }
+}
+
+/*
+ * Frame rates since the last report, the CAN driver's queues and the latency
+ * statistics kept by the firmware, which are then cleared.
+ */
+static void report(uint64_t now) {
+    double secs;
+    DWORD rx;
+
+    secs = (now - lastReportNs) / 1e9;
+    rx = halStats.rxFrames - lastStats.rxFrames;
+    printf("node %u NN %u CANID %u: tx %.0f/s rx %.0f/s bus %.1f%% hw overflow %lu"
+            " | txq max %u oflow %u rxq max %u oflow %u |",
+            halOptions.node, nodeID, canID,
+            (halStats.txFrames - lastStats.txFrames) / secs, rx / secs,
+            (halStats.busNs - lastStats.busNs) / (secs * 1e7),
+            (unsigned long)(halStats.rxOverflows - lastStats.rxOverflows),
+            maxCanTxFifo, txOflowCount, maxCanRxFifo, rxOflowCount);
+    printUs("rx latency", &rxLatency);
+    printUs("lookup", &eventLookup);
+    if (rx) {
+        printf(" transit %lu/%luus", 
+                (unsigned long)((halStats.transitNsTotal - lastStats.transitNsTotal) / rx / 1000),
+                (unsigned long)(halStats.transitNsMax / 1000));
+    }
+    printf("\n");
+    fflush(stdout);
+    latencyClear(&rxLatency);
+    latencyClear(&eventLookup);
+    halStats.transitNsMax = 0;
+    lastStats = halStats;
+    lastReportNs = now;
+}
+
+static void showLeds(void) {
+    BYTE i;
+
+    printf("leds:");
+    for (i=0; i<NUM_LEDS; i++) {
+        if (halLedLit(i)) printf(" %u", i);
+    }
+    printf(" | ours %08lx others %08lx\n", (unsigned long)ourControlled, (unsigned long)otherControlled);
+    fflush(stdout);
+}
+
+// Frames typed at the console, given as hex bytes starting with the opcode
+static void injectFrame(char * text) {
+    BYTE data[8];
+    BYTE len = 0;
+    char * end;
+
+    while (len < 8) {
+        data[len] = (BYTE)strtoul(text, &end, 16);
+        if (end == text) break;
+        text = end;
+        len++;
+    }
+    if (len) halInjectFrame(data, len);
+}
+
+// An NVSET from the FCU
+static void setNv(BYTE index, BYTE value) {
+    BYTE data[5];
+
+    data[0] = OPC_NVSET;
+    data[1] = nodeID >> 8;
+    data[2] = nodeID & 0xFF;
+    data[3] = index;
+    data[4] = value;
+    halInjectFrame(data, 5);
+}
+
+void hostCommand(char * text) {
+    uint64_t now;
+    char cmd[16];
+    unsigned a = 0;
+    unsigned b = 0;
+    int n;
+
+    now = halNowNs();
+    n = sscanf(text, "%15s %u %u", cmd, &a, &b);
+    if (n < 1) return;
+    if (strcmp(cmd, "rx") == 0) {
+        injectFrame(text + 2);
+    } else if ((strcmp(cmd, "nv") == 0) && (n == 3)) {
+        setNv(a, b);
+    } else if ((strcmp(cmd, "sw") == 0) && (n == 3)) {
+        halSetSwitch(a, b);
+    } else if ((strcmp(cmd, "press") == 0) && (n == 2) && (pressedSwitch < 0)) {
+        halSetSwitch(a, TRUE);
+        pressedSwitch = a;
+        releaseNs = now + PRESS_NS;
+    } else if ((strcmp(cmd, "pot") == 0) && (n == 2)) {
+        halPot = a;
+    } else if (strcmp(cmd, "leds") == 0) {
+        showLeds();
+    } else if (strcmp(cmd, "stats") == 0) {
+        report(now);
+    } else if (strcmp(cmd, "reset") == 0) {
+        hostReset();
+    } else if (strcmp(cmd, "quit") == 0) {
+        halSaveState();
+        exit(0);
+    } else {
+        printf("commands: sw <n> <0|1>, press <n>, pot <0-255>, nv <index> <value>, rx <hex bytes>,\n"
+                "          leds, stats, reset, quit\n");
+        fflush(stdout);
+    }
+}
+
+/**
+ * Called regularly from halService() to take commands and report.
+ */
+void hostPoll(void) {
+    uint64_t now;
+    char c;
+    ssize_t n;
+
+    now = halNowNs();
+    if ((pressedSwitch >= 0) && (now > releaseNs)) {
+        halSetSwitch(pressedSwitch, FALSE);
+        pressedSwitch = -1;
+    }
+    while (consoleOpen && (halOptions.simFd < 0) && (halOptions.replayFile == NULL) && ((n = read(0, &c, 1)) != -1)) {
+        if (n == 0) {
+            consoleOpen = FALSE;    // keep running without a console
+        } else if (c == '\n') {
+            line[lineLength] = '\0';
+            lineLength = 0;
+            hostCommand(line);
+        } else if (lineLength < sizeof(line) - 1) {
+            line[lineLength++] = c;
+        }
+    }
+    if (statsPeriod && (now - lastReportNs > statsPeriod * 1000000000ULL)) {
+        report(now);
+    }
+}
+
+int main(int argc, char ** argv) {
+    parseOptions(argc, argv);
+    fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+    halInit(argc, argv);
+    lastReportNs = halNowNs();
+    return firmwareMain();
+}
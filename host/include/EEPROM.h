@@ -0,0 +1,51 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   EEPROM.h
+ * Author: Ian
+ *
+ * Host build stand-in for the CBUS library EEPROM.h. The EEPROM is an
+ * array in hal.c.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef EEPROM_H
+#define	EEPROM_H
+
+#include "GenericTypeDefs.h"
+
+#define EE_TOP          0x3FE
+#define EE_BOOT_FLAG    0x3FF
+#define EE_CAN_ID       (EE_TOP-1)
+#define EE_NODE_ID      (EE_TOP-3)
+#define EE_FLIM_MODE    (EE_TOP-4)
+#define EE_VERSION      (EE_TOP-5)
+#define EE_APPLICATION  (EE_TOP-6)
+
+extern BYTE ee_read(WORD addr);
+extern void ee_write(WORD addr, BYTE data);
+extern WORD ee_read_short(WORD addr);
+extern void ee_write_short(WORD addr, WORD data);
+
+#endif	/* EEPROM_H */
@@ -0,0 +1,61 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   GenericTypeDefs.h
+ * Author: Ian
+ *
+ * Host build stand-in for the Microchip GenericTypeDefs.h. Sizes are those of
+ * the PIC18 so structures are laid out as on the module.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef GENERICTYPEDEFS_H
+#define	GENERICTYPEDEFS_H
+
+#include <stdint.h>
+
+typedef uint8_t     BYTE;
+typedef uint16_t    WORD;
+typedef uint32_t    DWORD;
+typedef uint8_t     BOOL;
+
+#define TRUE        1
+#define FALSE       0
+
+typedef union {
+    WORD Val;
+    BYTE v[2];
+    struct {
+        BYTE LB;
+        BYTE HB;
+    } byte;
+} WORD_VAL;
+
+typedef union {
+    DWORD Val;
+    WORD w[2];
+    BYTE v[4];
+} DWORD_VAL;
+
+#endif	/* GENERICTYPEDEFS_H */
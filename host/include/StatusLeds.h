@@ -0,0 +1,46 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   StatusLeds.h
+ * Author: Ian
+ *
+ * Host build stand-in for the CBUS library StatusLeds.h. The FLiM LEDs
+ * are not shown so these do nothing. As in the library the module's
+ * hardware settings, such as the FLiM switch, come from hwsettings.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef STATUSLEDS_H
+#define	STATUSLEDS_H
+
+#include "GenericTypeDefs.h"
+#include "hwsettings.h"
+
+extern void initStatusLeds(void);
+extern void startFLiMFlash(BOOL fast);
+extern void checkFlashing(void);
+extern void shortFlicker(void);
+extern void longFlicker(void);
+
+#endif	/* STATUSLEDS_H */
@@ -0,0 +1,54 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   TickTime.h
+ * Author: Ian
+ *
+ * Host build stand-in for the CBUS library TickTime.h. The tick counts the
+ * host's monotonic clock in the same 16us units as TMR0 on the module.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef TICKTIME_H
+#define	TICKTIME_H
+
+#include "GenericTypeDefs.h"
+
+typedef union {
+    DWORD Val;
+    WORD w[2];
+    BYTE v[4];
+} TickValue;
+
+#define ONE_SECOND              62500UL
+#define TWO_SECOND              (2*ONE_SECOND)
+#define HUNDRED_MILI_SECOND     (ONE_SECOND/10)
+#define ONE_MILI_SECOND         (ONE_SECOND/1000)
+
+extern void initTicker(BYTE priority);
+extern void tickISR(void);
+extern DWORD tickGet(void);
+extern DWORD tickTimeSince(TickValue t);
+
+#endif	/* TICKTIME_H */
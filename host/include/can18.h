@@ -0,0 +1,83 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   can18.h
+ * Author: Ian
+ *
+ * Host build stand-in for the CBUS library can18.h. The CAN driver itself
+ * is the firmware's cabdccan18.c.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef CAN18_H
+#define	CAN18_H
+
+#include "GenericTypeDefs.h"
+#include "TickTime.h"
+
+// Offsets of the fields of a CanPacket, the same as the ECAN buffer registers
+enum bufbytes {
+    con=0,
+    sidh,
+    sidl,
+    eidh,
+    eidl,
+    dlc,
+    d0,
+    d1,
+    d2,
+    d3,
+    d4,
+    d5,
+    d6,
+    d7
+};
+
+typedef struct {
+    BYTE buffer[14];
+} CanPacket;
+
+#define CANTX_FIFO_LEN          16
+#define CANRX_FIFO_LEN          32
+#define LARB_RETRIES            10
+#define CAN_TX_TIMEOUT          ONE_SECOND
+#define ENUMERATION_HOLDOFF     (2*HUNDRED_MILI_SECOND)
+#define ENUMERATION_TIMEOUT     HUNDRED_MILI_SECOND
+#define ENUM_ARRAY_SIZE         16
+#define DEFAULT_CANID           0x7E
+#define CLKMHZ                  16
+
+extern BYTE canID;
+extern BYTE clkMHz;
+
+extern void canInit(BYTE busNum, BYTE initCanID);
+extern BOOL setNewCanId(BYTE newCanId);
+extern BOOL canSend(BYTE *msg, BYTE msgLen);
+extern BOOL canTX(CanPacket *msg);
+extern BOOL canbusRecv(CanPacket *msg);
+extern BOOL canQueueRx(CanPacket *msg);
+extern void canInterruptHandler(void);
+extern void arraySetBit(BYTE * array, BYTE bitNum);
+
+#endif	/* CAN18_H */
@@ -0,0 +1,83 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   cbusdefs.h
+ * Author: Ian
+ *
+ * Host build stand-in for the CBUS library cbusdefs.h holding just the
+ * definitions the firmware uses.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef CBUSDEFS_H
+#define	CBUSDEFS_H
+
+#define MANU_MERG               165
+#define MTYP_CANCABDC           60
+
+#define PF_COMBI                3
+#define PF_COE                  64
+#define PF_BOOT                 8
+#define PB_CAN                  1
+#define CPUM_MICROCHIP          1
+
+#define OPC_TON                 0x05
+#define OPC_QNN                 0x0D
+#define OPC_SNN                 0x42
+#define OPC_RQNN                0x50
+#define OPC_NNACK               0x52
+#define OPC_NNLRN               0x53
+#define OPC_NNULN               0x54
+#define OPC_WRACK               0x59
+#define OPC_ENUM                0x5D
+#define OPC_NNRST               0x5E
+#define OPC_NNRSM               0x4F
+#define OPC_CMDERR              0x6F
+#define OPC_NVRD                0x71
+#define OPC_RDGN                0x87
+#define OPC_ACON                0x90
+#define OPC_ACOF                0x91
+#define OPC_NVSET               0x96
+#define OPC_NVANS               0x97
+#define OPC_ASON                0x98
+#define OPC_ASOF                0x99
+#define OPC_PNN                 0xB6
+#define OPC_DGN                 0xC7
+#define OPC_DTXC                0xE9
+#define OPC_ACON3               0xF0
+#define OPC_ACOF3               0xF1
+#define OPC_ACDAT               0xF6
+#define OPC_ASON3               0xF8
+#define OPC_ASOF3               0xF9
+
+#define CMDERR_INV_CMD          1
+#define CMDERR_NOT_LRN          2
+#define CMDERR_TOO_MANY_EVENTS  4
+#define CMDERR_INVALID_EVENT    7
+#define CMDERR_INV_NV_IDX       10
+#define CMDERR_INV_NV_VALUE     12
+
+#define CPU                     13      // P18F25K80
+
+#endif	/* CBUSDEFS_H */
@@ -0,0 +1,264 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   devincs.h
+ * Author: Ian
+ *
+ * Host build stand-in for the PIC18F25K80/26K80 device header. 
+ * 
+ * The special function registers used by the firmware are ordinary variables
+ * so the firmware compiles unchanged. Those which the hardware changes by 
+ * itself - the ECAN receive FIFO pointer and status, the operating mode, TMR1 
+ * and the ADC - are reached through an accessor in hal.c which brings the 
+ * register up to date before the firmware reads or writes it.
+ * The ECAN message buffers are 14 byte structures in the order of CanPacket 
+ * so (BYTE*)&TXB0CON and the receive buffer pointers work as on the module.
+ * The bit fields are at the same positions as on the PIC.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef DEVINCS_H
+#define	DEVINCS_H
+
+#include "GenericTypeDefs.h"
+
+/*
+ * ECAN message buffers.
+ */
+typedef struct {
+    BYTE con;
+    BYTE sidh;
+    BYTE sidl;
+    BYTE eidh;
+    BYTE eidl;
+    BYTE dlc;
+    BYTE d[8];
+} HostCanBuffer;
+
+#define HOST_TX_BUFFERS     3
+#define HOST_RX_BUFFERS     8       // RXB0, RXB1 and B0-B5 all used for receive
+
+extern volatile HostCanBuffer hostTxBuffer[HOST_TX_BUFFERS];
+extern volatile HostCanBuffer hostRxBuffer[HOST_RX_BUFFERS];
+
+#define TXB0CON     hostTxBuffer[0].con
+#define TXB0SIDH    hostTxBuffer[0].sidh
+#define TXB0SIDL    hostTxBuffer[0].sidl
+#define TXB0DLC     hostTxBuffer[0].dlc
+#define TXB1CON     hostTxBuffer[1].con
+#define TXB1SIDH    hostTxBuffer[1].sidh
+#define TXB1SIDL    hostTxBuffer[1].sidl
+#define TXB1DLC     hostTxBuffer[1].dlc
+#define TXB2CON     hostTxBuffer[2].con
+#define TXB2SIDH    hostTxBuffer[2].sidh
+#define TXB2SIDL    hostTxBuffer[2].sidl
+#define TXB2DLC     hostTxBuffer[2].dlc
+#define RXB0CON     hostRxBuffer[0].con
+#define RXB1CON     hostRxBuffer[1].con
+#define B0CON       hostRxBuffer[2].con
+#define B1CON       hostRxBuffer[3].con
+#define B2CON       hostRxBuffer[4].con
+#define B3CON       hostRxBuffer[5].con
+#define B4CON       hostRxBuffer[6].con
+#define B5CON       hostRxBuffer[7].con
+
+#define RXFUL       0x80            // receive buffer con bit
+
+typedef struct {
+    BYTE TXPRI0:1;
+    BYTE TXPRI1:1;
+    BYTE :1;
+    BYTE TXREQ:1;
+    BYTE TXERR:1;
+    BYTE TXLARB:1;
+    BYTE TXABT:1;
+    BYTE TXBIF:1;
+} TXBnCONbits_t;
+
+#define TXB0CONbits (*(volatile TXBnCONbits_t *)&TXB0CON)
+#define TXB1CONbits (*(volatile TXBnCONbits_t *)&TXB1CON)
+#define TXB2CONbits (*(volatile TXBnCONbits_t *)&TXB2CON)
+
+/*
+ * ECAN control and status. Mode 2, so CANCON<2:0> is the FIFO read pointer.
+ */
+extern volatile BYTE * hostCANCON(void);
+extern volatile BYTE * hostCANSTAT(void);
+extern volatile BYTE * hostCOMSTAT(void);
+
+#define CANCON      (*hostCANCON())
+#define CANSTAT     (*hostCANSTAT())
+#define COMSTAT     (*hostCOMSTAT())
+
+typedef struct {
+    BYTE :5;
+    BYTE OPMODE0:1;
+    BYTE OPMODE1:1;
+    BYTE OPMODE2:1;
+} CANSTATbits_t;
+
+typedef struct {
+    BYTE EWARN:1;
+    BYTE RXWARN:1;
+    BYTE TXWARN:1;
+    BYTE RXBP:1;
+    BYTE TXBP:1;
+    BYTE TXBO:1;
+    BYTE RXBnOVFL:1;
+    BYTE NOT_FIFOEMPTY:1;
+} COMSTATbits_t;
+
+#define CANSTATbits (*(volatile CANSTATbits_t *)hostCANSTAT())
+#define COMSTATbits (*(volatile COMSTATbits_t *)hostCOMSTAT())
+
+extern volatile BYTE ECANCON, BSEL0, BRGCON1, BRGCON2, BRGCON3, CIOCON, BIE0, TXBIE;
+extern volatile BYTE TXERRCNT, RXERRCNT;
+extern volatile BYTE RXM0SIDH, RXM0SIDL, RXM0EIDH, RXM0EIDL, RXM1SIDH, RXM1SIDL, RXM1EIDH, RXM1EIDL;
+extern volatile BYTE RXF0SIDL, RXFBCON0, RXFBCON1, RXFBCON2, RXFBCON3, RXFBCON4, RXFBCON5, RXFBCON6, RXFBCON7;
+extern volatile BYTE MSEL0, MSEL1, MSEL2, MSEL3;
+
+typedef struct {
+    BYTE :2;
+    BYTE TXB0IE:1;
+    BYTE TXB1IE:1;
+    BYTE TXB2IE:1;
+    BYTE :3;
+} TXBIEbits_t;
+
+#define TXBIEbits   (*(volatile TXBIEbits_t *)&TXBIE)
+
+/*
+ * Interrupt flags and enables. In ECAN modes 1 and 2 PIR5/PIE5 bit 0 is
+ * RXBnIF, bit 1 is FIFOWMIF and bit 4 is TXBnIF.
+ */
+extern volatile BYTE PIR1, PIR3, PIE3, IPR3, PIR5, PIE5, IPR5, RCON, INTCON, INTCON2;
+
+typedef struct {
+    BYTE RXB0IF:1;
+    BYTE RXB1IF:1;
+    BYTE TXB0IF:1;
+    BYTE TXB1IF:1;
+    BYTE TXB2IF:1;
+    BYTE ERRIF:1;
+    BYTE WAKIF:1;
+    BYTE IRXIF:1;
+} PIR5bits_t;
+
+typedef struct {
+    BYTE RXB0IE:1;
+    BYTE RXB1IE:1;
+    BYTE TXB0IE:1;
+    BYTE TXB1IE:1;
+    BYTE TXB2IE:1;
+    BYTE ERRIE:1;
+    BYTE WAKIE:1;
+    BYTE IRXIE:1;
+} PIE5bits_t;
+
+typedef struct {
+    BYTE :3;
+    BYTE SSPIF:1;
+    BYTE :4;
+} PIR1bits_t;
+
+typedef struct {
+    BYTE :1;
+    BYTE CCP1IF:1;
+    BYTE :6;
+} PIR3bits_t;
+
+typedef struct {
+    BYTE :6;
+    BYTE GIEL:1;
+    BYTE GIEH:1;
+} INTCONbits_t;
+
+typedef struct {
+    BYTE :7;
+    BYTE RBPU:1;
+} INTCON2bits_t;
+
+#define PIR5bits    (*(volatile PIR5bits_t *)&PIR5)
+#define PIE5bits    (*(volatile PIE5bits_t *)&PIE5)
+#define PIR1bits    (*(volatile PIR1bits_t *)&PIR1)
+#define PIR3bits    (*(volatile PIR3bits_t *)&PIR3)
+#define PIE3bits    (*(volatile struct { BYTE :1; BYTE CCP1IE:1; BYTE :6; } *)&PIE3)
+#define IPR3bits    (*(volatile struct { BYTE :1; BYTE CCP1IP:1; BYTE :6; } *)&IPR3)
+#define INTCONbits  (*(volatile INTCONbits_t *)&INTCON)
+#define INTCON2bits (*(volatile INTCON2bits_t *)&INTCON2)
+
+#define RXBnIF      PIR5bits.RXB0IF
+#define FIFOWMIF    PIR5bits.RXB1IF
+#define TXBnIF      PIR5bits.TXB2IF
+#define ERRIF       PIR5bits.ERRIF
+#define IRXIF       PIR5bits.IRXIF
+#define FIFOWMIE    PIE5bits.RXB1IE
+#define TXBnIE      PIE5bits.TXB2IE
+#define ERRIE       PIE5bits.ERRIE
+#define RXBnOVFL    COMSTATbits.RXBnOVFL
+
+#define ei()        INTCONbits.GIEH = 1;INTCONbits.GIEL = 1
+#define di()        INTCONbits.GIEH = 0;INTCONbits.GIEL = 0
+#define geti()      INTCONbits.GIEH
+
+/*
+ * TMR1 and CCP1 capture the start of frame of received frames.
+ * Reading TMR1L latches TMR1H.
+ */
+extern volatile BYTE * hostTMR1L(void);
+extern volatile BYTE TMR1H, T1CON, CCP1CON, CCPR1L, CCPR1H, CCPTMRS;
+
+#define TMR1L       (*hostTMR1L())
+#define T1CONbits   (*(volatile struct { BYTE TMR1ON:1; BYTE :7; } *)&T1CON)
+#define CCPTMRSbits (*(volatile struct { BYTE C1TSEL:1; BYTE :7; } *)&CCPTMRS)
+
+/*
+ * ADC. A conversion completes as soon as it is looked at.
+ */
+extern volatile BYTE * hostADCON0(void);
+extern volatile BYTE ADCON1, ADCON2, ADRESH, ADRESL, ANCON0, ANCON1;
+
+#define ADCON0      (*hostADCON0())
+#define ADCON0bits  (*(volatile struct { BYTE ADON:1; BYTE GO:1; BYTE :6; } *)hostADCON0())
+
+/*
+ * Ports, the MSSP and the rest.
+ */
+extern volatile BYTE PORTA, PORTB, PORTC, LATA, LATB, LATC, TRISA, TRISB, TRISC, WPUB;
+extern volatile BYTE SSPBUF, SSPCON1, SSPSTAT, OSCTUNE;
+
+#define PORTAbits   (*(volatile struct { BYTE RA0:1; BYTE RA1:1; BYTE RA2:1; BYTE RA3:1; BYTE :4; } *)&PORTA)
+#define LATCbits    (*(volatile struct { BYTE LATC0:1; BYTE LATC1:1; BYTE LATC2:1; BYTE LATC3:1; BYTE LATC4:1; BYTE :3; } *)&LATC)
+#define TRISAbits   (*(volatile struct { BYTE :5; BYTE TRISA5:1; BYTE :2; } *)&TRISA)
+#define TRISCbits   (*(volatile struct { BYTE TRISC0:1; BYTE TRISC1:1; BYTE :6; } *)&TRISC)
+#define SSPSTATbits (*(volatile struct { BYTE BF:1; BYTE :5; BYTE CKE:1; BYTE :1; } *)&SSPSTAT)
+#define OSCTUNEbits (*(volatile struct { BYTE :6; BYTE PLLEN:1; BYTE :1; } *)&OSCTUNE)
+
+extern void hostReset(void);
+
+#define Reset()     hostReset()
+#define Nop()
+#define ClrWdt()
+
+#endif	/* DEVINCS_H */
@@ -0,0 +1,599 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   layoutsim.c
+ * Author: Ian
+ *
+ * Layout simulator. Runs a number of panels, each a cabdc_host process with
+ * the unchanged firmware, on a simulated 125kbit/s CAN bus so that the bus
+ * load, the CAN driver queues and the time taken to act on the controls can
+ * be measured as panels are added. See "Layout simulator" in the README.
+ *
+ * The simulation moves forward in steps of a quantum, 50us by default. At the
+ * start of each step the operator actions which are due are given to the 
+ * panels, a frame whose time on the bus is over is delivered and, if the bus
+ * is free, the frames the panels have waiting are arbitrated. The lowest 
+ * identifier wins, so as all frames have the same priority bits it is the 
+ * lowest CANID. The bus is treated as having been free from the end of the
+ * last frame so the winner's start of frame is not rounded up to the step.
+ * Then every panel runs its firmware to the end of the step. See sim.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "cbusdefs.h"
+
+#define MAX_PANELS          99
+#define MAX_LINE            128
+#define SWEEP_STEP_MS       10          // pot sweeps move the pot this often
+#define ACTION_TIMEOUT_NS   1000000000ULL   // an action not answered by then is counted as unanswered
+#define LOAD_WINDOW_NS      100000000ULL    // bus load peak is over this period
+#define CAN_BIT_NS          8000ULL
+#define CAN_FRAME_BITS(dlc) (52 + 10*(((dlc) & 0x40) ? 0 : ((dlc) & 0x0F)))   // as hal.h
+#define IS_OWNERSHIP_CHANGE(d) (((d)[3] == 0xCD) && ((((d)[4] & 0x07) == 3) || (((d)[4] & 0x07) == 4)))  // take or release, as ownership.h
+
+/*
+ * Script.
+ */
+typedef struct {
+    uint64_t ns;
+    unsigned order;                     // keeps actions at the same time in script order
+    BYTE first;                         // panels first to last
+    BYTE last;
+    char text[SIM_TEXT_LEN];
+} Action;
+
+static Action * actions;
+static unsigned actionCount;
+static unsigned actionSize;
+
+/*
+ * Latency samples in microseconds.
+ */
+typedef struct {
+    uint32_t * v;
+    size_t count;
+    size_t size;
+} Samples;
+
+/*
+ * Panels.
+ */
+typedef struct {
+    pid_t pid;
+    int fd;
+    SimMsg report;                      // the last SIM_REPORT
+    BOOL stale;                         // report predates a SIM_TX_DONE
+    uint64_t controlSinceNs;            // oldest unanswered switch action, 0 if none
+    uint64_t speedSinceNs;              // oldest unanswered pot movement, 0 if none
+    DWORD txFrames;
+    BYTE txQueueMax;
+    uint64_t txQueueTotal;              // summed over the steps, for the average
+    BYTE rxQueueMax;
+    BYTE rxHardwareMax;
+} Panel;
+
+static Panel panels[MAX_PANELS];
+
+static unsigned panelCount = 2;
+static unsigned quantumNs = 50000;
+static unsigned loopNs = 0;             // 0 to leave to the panel
+static uint64_t endNs;
+static WORD baseNn = 300;
+static BYTE baseCanId = 1;
+static BOOL verbose;
+static const char * panelProgram;
+
+/*
+ * Bus.
+ */
+static BOOL busBusy;
+static BYTE busSender;
+static BYTE busTxBuffer;
+static VcanFrame busFrame;
+static uint64_t busFreeNs;              // end of the last frame
+static uint64_t busyNsTotal;
+static uint64_t * loadWindows;          // bus busy time in each LOAD_WINDOW_NS
+static DWORD frameCount;
+static DWORD idClashes;                 // two panels won arbitration with the same identifier
+
+static Samples arbitrationWait;         // TXREQ set to start of frame
+static Samples controlLatency;          // switch action to take/release end of frame
+static Samples speedLatency;            // pot movement to ACON3 end of frame
+static DWORD controlUnanswered;
+static DWORD speedUnanswered;
+static DWORD steps;
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [options] script\n"
+            "  -n, --panels N      number of panels (2)\n"
+            "  -t, --time SECS     simulated time (1s after the last action)\n"
+            "  -q, --quantum US    simulation step (50)\n"
+            "  -l, --loop-ns NS    simulated time between the firmware's tickGet() calls\n"
+            "  -a, --nn NN         node number of panel 0, the others follow on (300)\n"
+            "  -c, --canid ID      CANID of panel 0, the others follow on (1)\n"
+            "  -x, --panel PROG    panel program (cabdc_host beside this program)\n"
+            "  -v, --verbose       show the panels' output and their own reports at the end\n"
+            "script lines are <ms> <panel|first-last|*> <command>, where the command is a\n"
+            "panel console command or sweep <from> <to> <ms>. Lines for panels beyond\n"
+            "the number run are left out. Use - to read stdin.\n", name);
+    exit(2);
+}
+
+static void * grow(void * p, size_t * size, size_t itemSize) {
+    *size = *size ? *size * 2 : 256;
+    p = realloc(p, *size * itemSize);
+    if (p == NULL) {
+        perror("realloc");
+        exit(1);
+    }
+    return p;
+}
+
+static void addSample(Samples * s, uint64_t ns) {
+    if (s->count == s->size) {
+        s->v = grow(s->v, &s->size, sizeof(uint32_t));
+    }
+    s->v[s->count++] = (ns / 1000 > UINT32_MAX) ? UINT32_MAX : (uint32_t)(ns / 1000);
+}
+
+static void addAction(uint64_t ns, BYTE first, BYTE last, const char * text) {
+    size_t size = actionSize;
+
+    if (actionCount == actionSize) {
+        actions = grow(actions, &size, sizeof(Action));
+        actionSize = size;
+    }
+    actions[actionCount].ns = ns;
+    actions[actionCount].order = actionCount;
+    actions[actionCount].first = first;
+    actions[actionCount].last = last;
+    snprintf(actions[actionCount].text, SIM_TEXT_LEN, "%s", text);
+    actionCount++;
+}
+
+static int compareActions(const void * a, const void * b) {
+    const Action * x = a;
+    const Action * y = b;
+
+    if (x->ns != y->ns) return (x->ns < y->ns) ? -1 : 1;
+    return (x->order < y->order) ? -1 : 1;
+}
+
+static void readScript(const char * name) {
+    FILE * f;
+    char line[MAX_LINE];
+    char panelSpec[16];
+    double ms;
+    int used;
+    unsigned first, last, lineNo = 0;
+    unsigned from, to, sweepMs, t;
+    char * text;
+
+    f = strcmp(name, "-") ? fopen(name, "r") : stdin;
+    if (f == NULL) {
+        perror(name);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (sscanf(line, "%lf %15s %n", &ms, panelSpec, &used) < 2) {
+            if (strspn(line, " \t") != strlen(line)) {
+                fprintf(stderr, "%s:%u: expected <ms> <panels> <command>\n", name, lineNo);
+                exit(2);
+            }
+            continue;
+        }
+        text = line + used;
+        if (strcmp(panelSpec, "*") == 0) {
+            first = 0;
+            last = panelCount - 1;
+        } else if (sscanf(panelSpec, "%u-%u", &first, &last) != 2) {
+            first = last = atoi(panelSpec);
+        }
+        if (first > last) {
+            fprintf(stderr, "%s:%u: no panel %s\n", name, lineNo, panelSpec);
+            exit(2);
+        }
+        // a script can be written for more panels than are run
+        if (first >= panelCount) continue;
+        if (last >= panelCount) last = panelCount - 1;
+        if (sscanf(text, "sweep %u %u %u", &from, &to, &sweepMs) == 3) {
+            for (t=0; t<=sweepMs; t+=SWEEP_STEP_MS) {
+                char pot[16];
+
+                snprintf(pot, sizeof(pot), "pot %u", 
+                        sweepMs ? (unsigned)(from + ((int)to - (int)from) * (int)t / (int)sweepMs) : to);
+                addAction((uint64_t)(ms * 1e6) + t * 1000000ULL, first, last, pot);
+            }
+        } else {
+            addAction((uint64_t)(ms * 1e6), first, last, text);
+        }
+    }
+    if (f != stdin) fclose(f);
+    qsort(actions, actionCount, sizeof(Action), compareActions);
+}
+
+/*
+ * Talking to the panels.
+ */
+
+static void sendMsg(Panel * p, SimMsg * msg) {
+    if (send(p->fd, msg, sizeof(SimMsg), 0) != sizeof(SimMsg)) {
+        fprintf(stderr, "panel %ld has gone\n", (long)(p - panels));
+        exit(1);
+    }
+}
+
+static void readReport(Panel * p) {
+    if (recv(p->fd, &p->report, sizeof(SimMsg), 0) != sizeof(SimMsg)
+            || (p->report.type != SIM_REPORT)) {
+        fprintf(stderr, "panel %ld has gone\n", (long)(p - panels));
+        exit(1);
+    }
+    p->stale = FALSE;
+}
+
+static void startPanel(BYTE n) {
+    int sv[2];
+    char fd[8], nn[8], canId[8], loop[16];
+    int null;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    panels[n].fd = sv[0];
+    panels[n].pid = fork();
+    if (panels[n].pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (panels[n].pid == 0) {
+        null = open("/dev/null", O_RDWR);
+        dup2(null, 0);
+        if ( ! verbose) dup2(null, 1);
+        snprintf(fd, sizeof(fd), "%d", sv[1]);
+        snprintf(nn, sizeof(nn), "%u", baseNn + n);
+        snprintf(canId, sizeof(canId), "%u", baseCanId + n);
+        snprintf(loop, sizeof(loop), "%u", loopNs);
+        if (loopNs) {
+            execl(panelProgram, panelProgram, "--sim", fd, "--nn", nn, "--canid", canId, 
+                    "--loop-ns", loop, (char *)NULL);
+        } else {
+            execl(panelProgram, panelProgram, "--sim", fd, "--nn", nn, "--canid", canId, (char *)NULL);
+        }
+        perror(panelProgram);
+        _exit(1);
+    }
+    close(sv[1]);
+}
+
+static void sendText(Panel * p, const char * text) {
+    SimMsg msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SIM_COMMAND;
+    snprintf(msg.text, SIM_TEXT_LEN, "%s", text);
+    sendMsg(p, &msg);
+}
+
+// Give an action to its panels, noting it for the latency of the frame it should cause
+static void doAction(Action * a) {
+    unsigned n, sw, on;
+    Panel * p;
+
+    for (n=a->first; n<=a->last; n++) {
+        p = &panels[n];
+        sendText(p, a->text);
+        if ((sscanf(a->text, "press %u", &sw) == 1)
+                || ((sscanf(a->text, "sw %u %u", &sw, &on) == 2) && on)) {
+            if (p->controlSinceNs == 0) p->controlSinceNs = a->ns;
+        } else if (strncmp(a->text, "pot", 3) == 0) {
+            if (p->speedSinceNs == 0) p->speedSinceNs = a->ns;
+        }
+    }
+}
+
+// Actions which have had no frame within ACTION_TIMEOUT_NS are given up on
+static void expireActions(uint64_t now) {
+    unsigned n;
+
+    for (n=0; n<panelCount; n++) {
+        if (panels[n].controlSinceNs && (now - panels[n].controlSinceNs > ACTION_TIMEOUT_NS)) {
+            panels[n].controlSinceNs = 0;
+            controlUnanswered++;
+        }
+        if (panels[n].speedSinceNs && (now - panels[n].speedSinceNs > ACTION_TIMEOUT_NS)) {
+            panels[n].speedSinceNs = 0;
+            speedUnanswered++;
+        }
+    }
+}
+
+/*
+ * The bus.
+ */
+
+static WORD frameId(VcanFrame * f) {
+    return ((WORD)f->sidh << 3) | (f->sidl >> 5);
+}
+
+// The frame on the bus has finished
+static void completeFrame(void) {
+    SimMsg msg;
+    Panel * sender;
+    BYTE opc;
+    unsigned n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SIM_FRAME;
+    msg.frame = busFrame;
+    for (n=0; n<panelCount; n++) {
+        if (n != busSender) sendMsg(&panels[n], &msg);
+    }
+    sender = &panels[busSender];
+    msg.type = SIM_TX_DONE;
+    msg.txBuffer = busTxBuffer;
+    sendMsg(sender, &msg);
+    sender->stale = TRUE;
+    sender->txFrames++;
+    frameCount++;
+
+    opc = busFrame.d[0];
+    if (((opc == OPC_ASON3) || (opc == OPC_ASOF3) || ((opc == OPC_ACDAT) && IS_OWNERSHIP_CHANGE(busFrame.d)))
+            && sender->controlSinceNs) {
+        addSample(&controlLatency, busFrame.eofNs - sender->controlSinceNs);
+        sender->controlSinceNs = 0;
+    } else if ((opc == OPC_ACON3) && sender->speedSinceNs) {
+        addSample(&speedLatency, busFrame.eofNs - sender->speedSinceNs);
+        sender->speedSinceNs = 0;
+    }
+    busBusy = FALSE;
+}
+
+// Start the frame which wins arbitration, if any are waiting
+static void arbitrate(void) {
+    unsigned n;
+    int winner = -1;
+    uint64_t startNs = UINT64_MAX;
+    uint64_t ns;
+    BOOL clash = FALSE;
+    Panel * p;
+
+    // the bus became idle when the first frame was waiting, or when the last one finished
+    for (n=0; n<panelCount; n++) {
+        p = &panels[n];
+        if (p->report.pending && !p->stale && (p->report.ns < startNs)) startNs = p->report.ns;
+    }
+    if (startNs == UINT64_MAX) return;
+    if (startNs < busFreeNs) startNs = busFreeNs;
+    // everything waiting by then takes part
+    for (n=0; n<panelCount; n++) {
+        p = &panels[n];
+        if ( ! p->report.pending || p->stale || (p->report.ns > startNs)) continue;
+        if ((winner < 0) || (frameId(&p->report.frame) < frameId(&panels[winner].report.frame))) {
+            winner = n;
+            clash = FALSE;
+        } else if (frameId(&p->report.frame) == frameId(&panels[winner].report.frame)) {
+            clash = TRUE;
+        }
+    }
+    if (clash) idClashes++;
+    p = &panels[winner];
+    addSample(&arbitrationWait, startNs - p->report.ns);
+    busFrame = p->report.frame;
+    busFrame.sofNs = startNs;
+    ns = CAN_FRAME_BITS(busFrame.dlc) * CAN_BIT_NS;
+    busFrame.eofNs = startNs + ns;
+    busBusy = TRUE;
+    busSender = winner;
+    busTxBuffer = p->report.txBuffer;
+    busFreeNs = busFrame.eofNs;
+    busyNsTotal += ns;
+    loadWindows[startNs / LOAD_WINDOW_NS] += ns;
+}
+
+/*
+ * Results.
+ */
+
+static int compareSamples(const void * a, const void * b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static uint32_t percentile(Samples * s, unsigned pc) {
+    size_t i;
+
+    i = (s->count * pc + 99) / 100;
+    return s->v[i ? i - 1 : 0];
+}
+
+static void printSamples(const char * name, Samples * s) {
+    printf("  %-40s %7zu", name, s->count);
+    if (s->count == 0) {
+        printf("\n");
+        return;
+    }
+    qsort(s->v, s->count, sizeof(uint32_t), compareSamples);
+    printf(" %7u %7u %7u %7u\n", percentile(s, 50), percentile(s, 90), percentile(s, 99), 
+            s->v[s->count - 1]);
+}
+
+static void report(double wallSecs) {
+    unsigned n, w;
+    uint64_t peak = 0;
+    Panel * p;
+
+    for (w=0; w<=(endNs - 1) / LOAD_WINDOW_NS; w++) {
+        if (loadWindows[w] > peak) peak = loadWindows[w];
+    }
+    printf("%u panels, %.1fs simulated in %.1fs, %uus steps\n", panelCount, endNs / 1e9, wallSecs, 
+            quantumNs / 1000);
+    printf("bus: %lu frames, load %.1f%% average, %.1f%% peak over %llums, %lu CANID clashes\n",
+            (unsigned long)frameCount, busyNsTotal * 100.0 / endNs, peak * 100.0 / LOAD_WINDOW_NS,
+            LOAD_WINDOW_NS / 1000000, (unsigned long)idClashes);
+    printf("latency (us)                                 count     p50     p90     p99     max\n");
+    printSamples("waiting for the bus", &arbitrationWait);
+    printSamples("switch to take/release on the bus", &controlLatency);
+    printSamples("pot to ACON3 on the bus", &speedLatency);
+    printf("  unanswered after %llums: switch %lu pot %lu\n", ACTION_TIMEOUT_NS / 1000000,
+            (unsigned long)controlUnanswered, (unsigned long)speedUnanswered);
+    printf("panel   NN CANID  tx frames  txq avg  txq max  rxq max  hw rx max  hw overflows\n");
+    for (n=0; n<panelCount; n++) {
+        p = &panels[n];
+        printf("%5u %4u %5u %10lu %8.2f %8u %8u %10u %13lu\n", n, baseNn + n, baseCanId + n, 
+                (unsigned long)p->txFrames, steps ? (double)p->txQueueTotal / steps : 0.0, 
+                p->txQueueMax, p->rxQueueMax, p->rxHardwareMax, (unsigned long)p->report.rxOverflows);
+    }
+}
+
+static void parseOptions(int argc, char ** argv) {
+    static const struct option options[] = {
+        { "panels", required_argument, NULL, 'n' },
+        { "time", required_argument, NULL, 't' },
+        { "quantum", required_argument, NULL, 'q' },
+        { "loop-ns", required_argument, NULL, 'l' },
+        { "nn", required_argument, NULL, 'a' },
+        { "canid", required_argument, NULL, 'c' },
+        { "panel", required_argument, NULL, 'x' },
+        { "verbose", no_argument, NULL, 'v' },
+        { NULL, 0, NULL, 0 }
+    };
+    static char program[PATH_MAX];
+    ssize_t len;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "n:t:q:l:a:c:x:v", options, NULL)) != -1) {
+        switch (c) {
+            case 'n': panelCount = atoi(optarg); break;
+            case 't': endNs = (uint64_t)(atof(optarg) * 1e9); break;
+            case 'q': quantumNs = atoi(optarg) * 1000; break;
+            case 'l': loopNs = atoi(optarg); break;
+            case 'a': baseNn = strtoul(optarg, NULL, 0); break;
+            case 'c': baseCanId = strtoul(optarg, NULL, 0); break;
+            case 'x': panelProgram = optarg; break;
+            case 'v': verbose = TRUE; break;
+            default: usage(argv[0]);
+        }
+    }
+    // a step must be shorter than the shortest frame, 416us
+    if ((optind != argc - 1) || (panelCount < 1) || (panelCount > MAX_PANELS) 
+            || (baseCanId < 1) || (baseCanId + panelCount - 1 > 99)
+            || (quantumNs == 0) || (quantumNs > CAN_FRAME_BITS(0) * CAN_BIT_NS)) {
+        usage(argv[0]);
+    }
+    if (panelProgram == NULL) {
+        len = readlink("/proc/self/exe", program, sizeof(program) - 16);
+        if (len < 0) len = 0;
+        program[len] = '\0';
+        strcpy(strrchr(program, '/') ? strrchr(program, '/') + 1 : program, "cabdc_host");
+        panelProgram = program;
+    }
+}
+
+int main(int argc, char ** argv) {
+    struct timespec wallStart, wallEnd;
+    uint64_t now, until;
+    unsigned n, next = 0;
+    SimMsg msg;
+    Panel * p;
+
+    parseOptions(argc, argv);
+    readScript(argv[optind]);
+    if (endNs == 0) {
+        endNs = (actionCount ? actions[actionCount - 1].ns : 0) + 1000000000ULL;
+    }
+    loadWindows = calloc((endNs - 1) / LOAD_WINDOW_NS + 2, sizeof(uint64_t));
+    signal(SIGPIPE, SIG_IGN);
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+    for (n=0; n<panelCount; n++) {
+        startPanel(n);
+    }
+    for (n=0; n<panelCount; n++) {
+        readReport(&panels[n]);
+    }
+
+    for (now=0; now<endNs; now=until) {
+        until = now + quantumNs;
+        while ((next < actionCount) && (actions[next].ns <= now)) {
+            doAction(&actions[next++]);
+        }
+        expireActions(now);
+        if (busBusy && (busFreeNs <= now)) {
+            completeFrame();
+        }
+        if ( ! busBusy) {
+            arbitrate();
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.type = SIM_RUN;
+        msg.ns = now;
+        msg.untilNs = until;
+        for (n=0; n<panelCount; n++) {
+            sendMsg(&panels[n], &msg);
+        }
+        for (n=0; n<panelCount; n++) {
+            p = &panels[n];
+            readReport(p);
+            p->txQueueTotal += p->report.txQueue;
+            if (p->report.txQueue > p->txQueueMax) p->txQueueMax = p->report.txQueue;
+            if (p->report.rxQueue > p->rxQueueMax) p->rxQueueMax = p->report.rxQueue;
+            if (p->report.rxHardware > p->rxHardwareMax) p->rxHardwareMax = p->report.rxHardware;
+        }
+        steps++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+
+    // the panels' own reports come before ours
+    memset(&msg, 0, sizeof(msg));
+    for (n=0; n<panelCount; n++) {
+        if (verbose) {
+            sendText(&panels[n], "stats");
+        }
+        msg.type = SIM_QUIT;
+        sendMsg(&panels[n], &msg);
+        waitpid(panels[n].pid, NULL, 0);
+    }
+    report((wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9);
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   replay.c
+ * Author: Ian
+ *
+ * Replay of a frame trace through the host build. See replay.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "devincs.h"
+#include "can18.h"
+#include "module.h"
+#include "cbus.h"
+#include "sections.h"
+#include "switches.h"
+#include "hal.h"
+#include "replay.h"
+
+#define REPLAY_RX       0
+#define REPLAY_SWITCH   1
+#define REPLAY_COMMAND  2
+
+#define MAX_LINE        128
+
+typedef struct {
+    uint64_t ns;
+    BYTE type;
+    BYTE canId;         // REPLAY_RX
+    BYTE len;           // REPLAY_RX data bytes, REPLAY_SWITCH switch number
+    BYTE d[8];          // REPLAY_RX data, REPLAY_SWITCH d[0] is the state
+    char * text;        // REPLAY_COMMAND
+} ReplayEntry;
+
+static ReplayEntry * entries;
+static unsigned entryCount;
+static unsigned nextEntry;          // next frame or command to be given
+static unsigned nextSwitch;         // next switch change to be given
+
+static BOOL handling;               // the firmware is handling a frame
+static uint64_t handlingStartNs;
+static BYTE handledMsg[d7+1];
+static DWORD framesHandled;
+static uint64_t handlingNsTotal;
+static uint64_t handlingNsMin = ~0ULL;
+static uint64_t handlingNsMax;
+static DWORD framesSent;
+static BYTE ledsShown[(NUM_LEDS + 7) / 8];
+
+static uint64_t cpuNs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void printTime(void) {
+    printf("%10.3f ", halNowNs() / 1e6);
+}
+
+/**
+ * Read the trace.
+ * @param file the trace, - for stdin
+ * @param offsetMs when the trace starts after the panel powers up
+ */
+void replayOpen(const char * file, unsigned offsetMs) {
+    FILE * f;
+    char line[MAX_LINE];
+    char cmd[16];
+    char word[4];
+    double ms;
+    int used;
+    unsigned lineNo = 0;
+    unsigned a, b;
+    size_t size = 0;
+    ReplayEntry * e;
+    char * text;
+    char * end;
+
+    f = strcmp(file, "-") ? fopen(file, "r") : stdin;
+    if (f == NULL) {
+        perror(file);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (sscanf(line, "%lf %15s %n", &ms, cmd, &used) < 2) {
+            if (strspn(line, " \t") != strlen(line)) {
+                fprintf(stderr, "%s:%u: expected <ms> <entry>\n", file, lineNo);
+                exit(2);
+            }
+            continue;
+        }
+        if (entryCount == size) {
+            size = size ? size * 2 : 256;
+            entries = realloc(entries, size * sizeof(ReplayEntry));
+            if (entries == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        e = &entries[entryCount];
+        memset(e, 0, sizeof(*e));
+        e->ns = (uint64_t)((ms + offsetMs) * 1e6);
+        if ((entryCount > 0) && (e->ns < entries[entryCount - 1].ns)) {
+            fprintf(stderr, "%s:%u: entries must be in time order\n", file, lineNo);
+            exit(2);
+        }
+        text = line + used;
+        if (strcmp(cmd, "rx") == 0) {
+            e->type = REPLAY_RX;
+            e->canId = (BYTE)strtoul(text, &end, 0);
+            if (end == text) {
+                fprintf(stderr, "%s:%u: no frame\n", file, lineNo);
+                exit(2);
+            }
+            text = end;
+            if (sscanf(text, " %3s", word) == 1 && strcmp(word, "rtr") == 0) {
+                e->len = HAL_RTR;
+            }
+            while (e->len < 8) {                // none for an enumeration reply
+                e->d[e->len] = (BYTE)strtoul(text, &end, 16);
+                if (end == text) break;
+                text = end;
+                e->len++;
+            }
+        } else if ((strcmp(cmd, "switch") == 0) && (sscanf(text, "%u %u", &a, &b) == 2)) {
+            e->type = REPLAY_SWITCH;
+            e->len = a;
+            e->d[0] = b;
+        } else {
+            e->type = REPLAY_COMMAND;
+            e->text = strdup(line + strspn(line, " \t0123456789.-"));
+        }
+        entryCount++;
+    }
+    if (f != stdin) fclose(f);
+}
+
+static void printFrame(BYTE canId, BYTE * data, BYTE len, BOOL pad) {
+    BYTE i;
+
+    printf("%3u", canId);
+    for (i=0; i<len; i++) printf(" %02X", data[i]);
+    if (pad) for (; i<8; i++) printf("   ");
+}
+
+// Show the LEDs when they change
+static void checkLeds(void) {
+    BYTE shown[sizeof(ledsShown)];
+    BYTE i;
+
+    memset(shown, 0, sizeof(shown));
+    for (i=0; i<NUM_LEDS; i++) {
+        if (halLedLit(i)) shown[i/8] |= 1 << (i%8);
+    }
+    if (memcmp(shown, ledsShown, sizeof(shown)) == 0) return;
+    memcpy(ledsShown, shown, sizeof(shown));
+    printTime();
+    printf("leds");
+    for (i=0; i<NUM_LEDS; i++) {
+        if (shown[i/8] & (1 << (i%8))) printf(" %u", i);
+    }
+    printf(" | ours %08lx others %08lx\n", (unsigned long)ourControlled, (unsigned long)otherControlled);
+}
+
+static void finish(void) {
+    checkLeds();
+    printf("replayed %u entries: %lu frames handled", entryCount, (unsigned long)framesHandled);
+    if (framesHandled) {
+        printf(" in %.1f/%.1f/%.1fus (min/avg/max host CPU)", handlingNsMin / 1e3,
+                handlingNsTotal / 1e3 / framesHandled, handlingNsMax / 1e3);
+    }
+    printf(", %lu frames sent\n", (unsigned long)framesSent);
+    fflush(stdout);
+    exit(0);
+}
+
+/**
+ * Give the frames and commands which are due. Called from halService().
+ */
+void replayService(uint64_t now) {
+    ReplayEntry * e;
+
+    while ((nextEntry < entryCount) && (entries[nextEntry].ns <= now)) {
+        e = &entries[nextEntry++];
+        if (e->type == REPLAY_RX) {
+            halReceive(e->canId, e->d, e->len);
+        } else if (e->type == REPLAY_COMMAND) {
+            printTime();
+            printf("%s\n", e->text);
+            hostCommand(e->text);
+        }
+    }
+    checkLeds();
+    if ((nextEntry == entryCount) && (nextSwitch == entryCount) 
+            && (now > (entryCount ? entries[entryCount - 1].ns : 0) + REPLAY_SETTLE_NS)) {
+        finish();
+    }
+}
+
+/**
+ * Give the switch changes which are due. Called as the firmware's main loop 
+ * looks for a frame, which is where switch_pressed() is called from on the module.
+ */
+void replaySwitches(void) {
+    ReplayEntry * e;
+    BYTE row;
+    BYTE bit;
+
+    while ((nextSwitch < entryCount) && (entries[nextSwitch].ns <= halNowNs())) {
+        e = &entries[nextSwitch++];
+        if ((e->type != REPLAY_SWITCH) || (e->len >= 32 * NUM_MATRICES)) continue;
+        printTime();
+        printf("switch %u %u\n", e->len, e->d[0]);
+        // the switch matrix has to agree or the scan would see the change too
+        halSetSwitch(e->len, e->d[0]);
+        row = (e->len/32)*8 + (e->len & 7);
+        bit = 1 << ((e->len/8) & 3);
+        switch_matrix[row] = e->d[0] ? (switch_matrix[row] | bit) : (switch_matrix[row] & ~bit);
+        switch_pressed(e->len, e->d[0] ? bit : 0);
+    }
+}
+
+/*
+ * The firmware handles a frame from cbusMsgReceived() returning it until 
+ * FLiMSWCheck(), which the main loop calls next.
+ */
+void replayFrameStart(BYTE * msg) {
+    memcpy(handledMsg, msg, sizeof(handledMsg));
+    handling = TRUE;
+    handlingStartNs = cpuNs();
+}
+
+void replayFrameEnd(void) {
+    uint64_t ns;
+
+    if ( ! handling) return;
+    ns = cpuNs() - handlingStartNs;
+    handling = FALSE;
+    framesHandled++;
+    handlingNsTotal += ns;
+    if (ns < handlingNsMin) handlingNsMin = ns;
+    if (ns > handlingNsMax) handlingNsMax = ns;
+    printTime();
+    printf("rx ");
+    printFrame(((handledMsg[sidh] << 3) | (handledMsg[sidl] >> 5)) & 0x7F, handledMsg + d0, 
+            handledMsg[dlc] & 0x0F, TRUE);
+    printf(" handled in %.1fus\n", ns / 1e3);
+}
+
+void replayFrameSent(VcanFrame * frame) {
+    framesSent++;
+    printTime();
+    printf("tx ");
+    printFrame(((frame->sidh << 3) | (frame->sidl >> 5)) & 0x7F, frame->d, 
+            (frame->dlc & 0x40) ? 0 : (frame->dlc & 0x0F), FALSE);
+    printf("\n");
+}
@@ -0,0 +1,61 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   replay.h
+ * Author: Ian
+ *
+ * Replay of a frame trace through the host build. The trace is either read
+ * from a module with cabdc_trace or written by hand, one entry per line:
+ *   <ms> rx <canid> <hex bytes>    a frame received from another module
+ *   <ms> rx <canid> rtr            an enumeration request, or no bytes for a reply
+ *   <ms> switch <n> <0|1>          switch_pressed(n, state)
+ *   <ms> <command>                 any console command, e.g. nv, pot or press
+ * Times are from the start of the trace. Frames are put in the ECAN receive
+ * buffers at their time, to resolution of the simulated clock, and switch
+ * changes are passed to switch_pressed() at the start of the firmware's next
+ * main loop, as on the module. The clock is simulated as under cabdc_sim so 
+ * the replay is the same every time.
+ *
+ * As it goes the replay prints each frame with how long the firmware took to
+ * handle it, each frame transmitted and each change of the LEDs.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef REPLAY_H
+#define	REPLAY_H
+
+#include "GenericTypeDefs.h"
+#include "vcan.h"
+
+#define REPLAY_OFFSET_MS    3000    // default start of the trace, once the panel has started
+#define REPLAY_SETTLE_NS    1000000000ULL   // run on this long after the last entry
+
+extern void replayOpen(const char * file, unsigned offsetMs);
+extern void replayService(uint64_t now);
+extern void replaySwitches(void);
+extern void replayFrameStart(BYTE * msg);
+extern void replayFrameEnd(void);
+extern void replayFrameSent(VcanFrame * frame);
+
+#endif	/* REPLAY_H */
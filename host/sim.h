@@ -0,0 +1,72 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   sim.h
+ * Author: Ian
+ *
+ * Messages between the layout simulator, cabdc_sim, and the panels it runs.
+ *
+ * Under the simulator each panel is a cabdc_host process started with --sim
+ * and connected to the simulator by a socket. The panel's clock only moves 
+ * when the simulator lets it. The simulator sends SIM_RUN to every panel and
+ * each runs its firmware until its clock reaches untilNs, then answers with
+ * SIM_REPORT giving the highest priority frame waiting in its transmit 
+ * buffers and its queue depths. The simulator owns the bus: it arbitrates
+ * between the waiting frames, holds the bus for the winner's frame time and
+ * then delivers the frame to the others as SIM_FRAME and tells the sender
+ * with SIM_TX_DONE. These are sent, along with operator actions as 
+ * SIM_COMMAND, before the next SIM_RUN.
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef SIM_H
+#define	SIM_H
+
+#include "GenericTypeDefs.h"
+#include "vcan.h"
+
+#define SIM_RUN         1       // simulator to panel: run from ns until untilNs
+#define SIM_FRAME       2       // simulator to panel: frame received
+#define SIM_TX_DONE     3       // simulator to panel: the frame in transmit buffer txBuffer has been sent
+#define SIM_COMMAND     4       // simulator to panel: console command in text
+#define SIM_QUIT        5       // simulator to panel: exit
+#define SIM_REPORT      6       // panel to simulator: state at the end of a run
+
+#define SIM_TEXT_LEN    64
+
+typedef struct {
+    BYTE type;
+    BYTE pending;           // SIM_REPORT: a frame is waiting in txBuffer
+    BYTE txBuffer;
+    BYTE txQueue;           // SIM_REPORT: frames in the CAN driver's software transmit fifo
+    BYTE rxQueue;           // SIM_REPORT: frames in the software receive fifo
+    BYTE rxHardware;        // SIM_REPORT: hardware receive buffers full
+    DWORD rxOverflows;      // SIM_REPORT: frames lost with all hardware buffers full
+    uint64_t ns;            // SIM_RUN: the time now. SIM_REPORT: when the frame started waiting
+    uint64_t untilNs;       // SIM_RUN
+    VcanFrame frame;        // SIM_FRAME, and SIM_REPORT when pending
+    char text[SIM_TEXT_LEN];    // SIM_COMMAND
+} SimMsg;
+
+#endif	/* SIM_H */
@@ -0,0 +1,301 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   tracedump.c
+ * Author: Ian
+ *
+ * cabdc_trace reads the frame trace from a panel (see trace.h) and writes it
+ * in the form cabdc_host --replay takes (see replay.h). It talks to the layout
+ * through a CAN USB interface using the GridConnect protocol, such as a 
+ * CANUSB4, or reads a GridConnect log of the transfer captured by another 
+ * tool when no device is given.
+ *
+ * Created on 19 October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/select.h>
+
+// From the firmware, which is not built into this tool
+#define OPC_DTXC            0xE9
+#define BULK_NV_STREAM_ID   0xDC
+#define BULK_NV_FRAME_LEN   5
+#define BULK_TRACE_READ     'T'
+#define BULK_TRACE_DATA     'F'
+#define TRACE_ENTRY_LEN     14
+#define TRACE_SWITCH        0x80
+#define TICK_US             16
+
+#define TOOL_CANID          0x7E    // the CANID our requests are sent with
+#define REPLY_TIMEOUT_MS    2000
+#define MAX_MESSAGE         256
+#define MAX_ENTRIES         256
+
+static int fd = -1;                 // the CAN interface, -1 when reading a log
+static FILE * in;
+static unsigned nodeNumber;
+
+static uint8_t message[MAX_MESSAGE];    // the long message being received
+static unsigned messageLength;
+static unsigned messageCrc;
+static unsigned messageReceived;
+static uint8_t messageStream;
+
+static uint8_t entries[MAX_ENTRIES][TRACE_ENTRY_LEN];
+static unsigned entryCount;
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s -a NN [-d DEVICE] [LOG]\n"
+            "  -a, --nn NN         node number of the panel\n"
+            "  -d, --device DEV    CAN USB interface to read the trace through, otherwise\n"
+            "                      a GridConnect log of the transfer is read from LOG or stdin\n",
+            name);
+    exit(2);
+}
+
+static unsigned crc16(uint8_t * data, unsigned len) {
+    unsigned crc = 0;
+    unsigned i;
+
+    while (len--) {
+        crc ^= *data++ << 8;
+        for (i=0; i<8; i++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return crc & 0xFFFF;
+}
+
+static void sendFrame(uint8_t * data, unsigned len) {
+    char text[32];
+    unsigned n;
+    unsigned i;
+
+    n = sprintf(text, ":S%02X%02XN", 0xB0 | (TOOL_CANID >> 3), (TOOL_CANID & 7) << 5);
+    for (i=0; i<len; i++) n += sprintf(text + n, "%02X", data[i]);
+    n += sprintf(text + n, ";");
+    if (write(fd, text, n) != (ssize_t)n) {
+        perror("write");
+        exit(1);
+    }
+    usleep(2000);
+}
+
+// Send a request as a long message on BULK_NV_STREAM_ID
+static void sendRequest(unsigned first) {
+    uint8_t request[BULK_NV_FRAME_LEN];
+    uint8_t frame[8];
+    unsigned crc;
+
+    request[0] = BULK_TRACE_READ;
+    request[1] = nodeNumber >> 8;
+    request[2] = nodeNumber & 0xFF;
+    request[3] = first;
+    request[4] = 255;
+    crc = crc16(request, sizeof(request));
+    frame[0] = OPC_DTXC;
+    frame[1] = BULK_NV_STREAM_ID;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = sizeof(request);
+    frame[5] = crc >> 8;
+    frame[6] = crc & 0xFF;
+    frame[7] = 0;
+    sendFrame(frame, 8);
+    frame[2] = 1;
+    memcpy(frame + 3, request, sizeof(request));
+    sendFrame(frame, 8);
+}
+
+// The next GridConnect frame, FALSE on timeout or at the end of the log
+static int readFrame(unsigned * canId, uint8_t * data, unsigned * len) {
+    static char text[64];
+    static unsigned textLen;
+    unsigned header;
+    unsigned i;
+    fd_set fds;
+    struct timeval tv;
+    int c;
+    char ch;
+    char * n;
+
+    for (;;) {
+        if (fd < 0) {
+            c = fgetc(in);
+            if (c == EOF) return 0;
+        } else {
+            FD_ZERO(&fds);
+            FD_SET(fd, &fds);
+            tv.tv_sec = REPLY_TIMEOUT_MS / 1000;
+            tv.tv_usec = (REPLY_TIMEOUT_MS % 1000) * 1000;
+            if (select(fd + 1, &fds, NULL, NULL, &tv) <= 0) return 0;
+            if (read(fd, &ch, 1) != 1) return 0;
+            c = ch;
+        }
+        if (c == ':') {
+            textLen = 0;
+        } else if ((c == ';') && (textLen > 0)) {
+            text[textLen] = '\0';
+            textLen = 0;
+            // S<sidh><sidl>N<data>, extended frames are not CBUS
+            n = strchr(text, 'N');
+            if ((text[0] != 'S') || (n == NULL) || (sscanf(text + 1, "%4x", &header) != 1)) continue;
+            *canId = ((header >> 5) & 0x7F);
+            *len = strlen(n + 1) / 2;
+            if (*len > 8) *len = 8;
+            for (i=0; i<*len; i++) {
+                sscanf(n + 1 + 2*i, "%2hhx", &data[i]);
+            }
+            return 1;
+        } else if (textLen < sizeof(text) - 1) {
+            text[textLen++] = c;
+        }
+    }
+}
+
+/*
+ * Receive the next BULK_TRACE_DATA message from the panel. Its replies are on
+ * the stream numbered with its CANID, which we learn from the first.
+ */
+static int receiveReply(void) {
+    unsigned canId;
+    unsigned len;
+    uint8_t data[8];
+    unsigned seq;
+
+    while (readFrame(&canId, data, &len)) {
+        if ((len < 3) || (data[0] != OPC_DTXC) || (data[1] != canId)) continue;
+        seq = data[2];
+        if (seq == 0) {
+            if (len < 7) continue;
+            messageStream = canId;
+            messageLength = (data[3] << 8) | data[4];
+            messageCrc = (data[5] << 8) | data[6];
+            messageReceived = 0;
+            if (messageLength > MAX_MESSAGE) messageLength = 0;
+            continue;
+        }
+        if ((canId != messageStream) || (messageLength == 0)
+                || (seq != messageReceived / BULK_NV_FRAME_LEN + 1)) continue;
+        len -= 3;
+        if (len > messageLength - messageReceived) len = messageLength - messageReceived;
+        memcpy(message + messageReceived, data + 3, len);
+        messageReceived += len;
+        if (messageReceived < messageLength) continue;
+        if ((crc16(message, messageLength) == messageCrc) && (messageLength >= 5)
+                && (message[0] == BULK_TRACE_DATA) && (((message[1] << 8) | message[2]) == nodeNumber)) {
+            return 1;
+        }
+        messageLength = 0;
+    }
+    return 0;
+}
+
+static void printEntries(void) {
+    unsigned i;
+    unsigned j;
+    uint32_t tick;
+    uint32_t tick0 = 0;
+    uint8_t * e;
+
+    for (i=0; i<entryCount; i++) {
+        e = entries[i];
+        tick = ((uint32_t)e[0] << 24) | ((uint32_t)e[1] << 16) | (e[2] << 8) | e[3];
+        if (i == 0) tick0 = tick;
+        printf("%.3f ", (double)(tick - tick0) * TICK_US / 1000);
+        if ((e[4] & ~1) == TRACE_SWITCH) {
+            printf("switch %u %u\n", e[5], e[4] & 1);
+        } else {
+            printf("rx %u", e[4]);
+            for (j=0; (j<e[5]) && (j<8); j++) printf(" %02X", e[6 + j]);
+            printf("\n");
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    static const struct option options[] = {
+        { "nn", required_argument, NULL, 'a' },
+        { "device", required_argument, NULL, 'd' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char * device = NULL;
+    struct termios tio;
+    unsigned first = 0;
+    unsigned count;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "a:d:", options, NULL)) != -1) {
+        switch (c) {
+            case 'a': nodeNumber = strtoul(optarg, NULL, 0); break;
+            case 'd': device = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if ((nodeNumber == 0) || (nodeNumber > 0xFFFF) || (device && (optind < argc))) usage(argv[0]);
+    if (device) {
+        fd = open(device, O_RDWR | O_NOCTTY);
+        if (fd < 0) {
+            perror(device);
+            return 1;
+        }
+        if (tcgetattr(fd, &tio) == 0) {
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B115200);
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    } else {
+        in = (optind < argc) ? fopen(argv[optind], "r") : stdin;
+        if (in == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    // Reading from entry 0 holds the trace until the newest has been read
+    for (;;) {
+        if (fd >= 0) sendRequest(first);
+        if ( ! receiveReply()) {
+            if ((fd < 0) && (entryCount > 0)) break;    // the end of the log
+            fprintf(stderr, "no reply from node %u\n", nodeNumber);
+            return 1;
+        }
+        if (message[3] != (first & 0xFF)) continue;
+        count = message[4];
+        if ((count == 0) || (messageLength < 5 + count * TRACE_ENTRY_LEN)) break;
+        if (entryCount + count > MAX_ENTRIES) count = MAX_ENTRIES - entryCount;
+        memcpy(entries[entryCount], message + 5, count * TRACE_ENTRY_LEN);
+        entryCount += count;
+        first += count;
+        if (entryCount == MAX_ENTRIES) break;
+    }
+    printEntries();
+    return 0;
+}
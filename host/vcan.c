@@ -0,0 +1,129 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   vcan.c
+ * Author: Ian
+ *
+ * Virtual CAN bus over UDP on the loopback interface. See vcan.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "vcan.h"
+
+static int vcanSocket = -1;
+static BYTE vcanNode;
+static BYTE vcanNodes;
+static WORD vcanBasePort;
+
+static void vcanAddress(struct sockaddr_in * addr, BYTE node) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(vcanBasePort + node);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+/**
+ * Join the bus.
+ * @param node our position on the bus
+ * @param nodes the number of panels on the bus
+ * @param basePort the UDP port of node 0
+ * @return TRUE if the port could be bound
+ */
+BOOL vcanOpen(BYTE node, BYTE nodes, WORD basePort) {
+    struct sockaddr_in addr;
+    int size;
+
+    vcanNode = node;
+    vcanNodes = nodes;
+    vcanBasePort = basePort;
+    vcanSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (vcanSocket < 0) {
+        perror("vcan socket");
+        return FALSE;
+    }
+    // room for a burst of frames whilst the firmware is busy
+    size = 256 * 1024;
+    setsockopt(vcanSocket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    vcanAddress(&addr, node);
+    if (bind(vcanSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("vcan bind");
+        close(vcanSocket);
+        vcanSocket = -1;
+        return FALSE;
+    }
+    fcntl(vcanSocket, F_SETFL, O_NONBLOCK);
+    return TRUE;
+}
+
+/**
+ * Put a frame on the bus. It goes to every other panel, whether or not it is
+ * running.
+ */
+void vcanSend(VcanFrame * frame) {
+    struct sockaddr_in addr;
+    BYTE n;
+
+    if (vcanSocket < 0) return;
+    for (n=0; n<vcanNodes; n++) {
+        if (n == vcanNode) continue;
+        vcanAddress(&addr, n);
+        sendto(vcanSocket, frame, sizeof(VcanFrame), 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+}
+
+/**
+ * Take the next frame off the bus.
+ * @return TRUE if there was one
+ */
+BOOL vcanReceive(VcanFrame * frame) {
+    if (vcanSocket < 0) return FALSE;
+    return recv(vcanSocket, frame, sizeof(VcanFrame), 0) == sizeof(VcanFrame);
+}
+
+/**
+ * Wait for a frame to arrive.
+ * @param us the longest to wait
+ */
+void vcanWait(unsigned us) {
+    struct pollfd fd;
+
+    if (vcanSocket < 0) return;
+    fd.fd = vcanSocket;
+    fd.events = POLLIN;
+    poll(&fd, 1, 0);
+    if ( ! (fd.revents & POLLIN)) {
+        struct timespec timeout = { 0, us * 1000L };
+        ppoll(&fd, 1, &timeout, NULL);
+    }
+}
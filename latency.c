@@ -0,0 +1,79 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   latency.c
+ * Author: Ian
+ * 
+ * Collect latency statistics using the CAN receive timestamps.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "GenericTypeDefs.h"
+#include "latency.h"
+#include "cabdccan18.h"
+
+LatencyStats rxLatency;
+LatencyStats eventLookup;
+
+void initLatency(void) {
+    latencyClear(&rxLatency);
+    latencyClear(&eventLookup);
+}
+
+void latencyClear(LatencyStats * stats) {
+    stats->min = 0xFFFF;
+    stats->max = 0;
+    stats->total = 0;
+    stats->count = 0;
+}
+
+/**
+ * Add a measurement to the statistics. When the count would overflow the 
+ * total and count are halved so the average keeps following recent values.
+ * @param stats the statistics to be updated
+ * @param ticks the measured interval
+ */
+void latencyRecord(LatencyStats * stats, WORD ticks) {
+    if (ticks < stats->min) stats->min = ticks;
+    if (ticks > stats->max) stats->max = ticks;
+    if (stats->count == 0xFFFF) {
+        stats->total >>= 1;
+        stats->count >>= 1;
+    }
+    stats->total += ticks;
+    stats->count++;
+}
+
+WORD latencyAverage(LatencyStats * stats) {
+    if (stats->count == 0) return 0;
+    return (WORD)(stats->total / stats->count);
+}
+
+/**
+ * Record the time the message currently being processed has spent queued 
+ * since its start of frame was seen by the ECAN.
+ */
+void recordRxLatency(void) {
+    latencyRecord(&rxLatency, canTimestampNow() - canRxTimestamp);
+}
@@ -0,0 +1,68 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   latency.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef LATENCY_H
+#define	LATENCY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "cabdccan18.h"
+    
+/*
+ * Running statistics of a time interval. All times are in CAN timestamp ticks
+ * of CAN_TIMESTAMP_US microseconds.
+ */
+typedef struct {
+    WORD min;
+    WORD max;
+    DWORD total;
+    WORD count;
+} LatencyStats;
+
+extern LatencyStats rxLatency;      // hardware reception to processEvent()
+extern LatencyStats eventLookup;    // library processing of an event, including the table lookup
+
+extern void initLatency(void);
+extern void latencyClear(LatencyStats * stats);
+extern void latencyRecord(LatencyStats * stats, WORD ticks);
+extern WORD latencyAverage(LatencyStats * stats);
+extern void recordRxLatency(void);
+
+// Opcodes of the ACON/ACOF/ASON/ASOF families with 0-3 data bytes
+#define IS_EVENT_OPC(opc)   ((((opc) & 0x90) == 0x90) && (((opc) & 0x06) == 0))
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* LATENCY_H */
+
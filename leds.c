@@ -34,12 +34,20 @@
 #include "cabdcNv.h"
 #include "candccab.h"
 #include "cbus.h"
+#include "board.h"
 
+// The IO is given by the board description header. On the CANPAN
 // RB4 - RB7 are used to drive the LED Anodes
 // MSSP SSI Master is used to provide 8 bits for cathodes
 
+// Matrix m uses led_matrix[4m to 4m+3] and its cathode driver is chained after
+// that of matrix m-1.
+
 static unsigned char current_row = 0;
-unsigned char led_matrix[4];
+unsigned char led_matrix[4 * NUM_MATRICES];
+static const rom unsigned char anodes[4] = {
+    BOARD_LED_ANODES(0), BOARD_LED_ANODES(1), BOARD_LED_ANODES(2), BOARD_LED_ANODES(3)
+};
 
 /**
  * Turn on an LED. No is 0-31.
@@ -67,50 +75,31 @@ unsigned char testLed(unsigned char no) {
 
 void initLeds() {
     unsigned char i;
-    for (i=0; i<4; i++) {
+    for (i=0; i<4 * NUM_MATRICES; i++) {
         led_matrix[i] = 0;
     }
-    TRISC = 0x80;   // RC7 is the CAN Rx
-    LATB = 0xF0;    // LED drivers off
-    TRISB = 0xf;    // upper 4 bits are outputs, lower 4 are inputs
-    //Set up the MSSP to drive the switch matrix
-    SSPCON1 = 0x22; // Enable Master and clock for Fosc/64
-    SSPSTATbits.CKE = 1;
+    BOARD_LED_INIT();
 }
 
 /**
  * Called every 2ms to load the next row of the LED matrix
  */
 void pollLeds() {
-    unsigned char dummy;
-    unsigned char anodes;
-    unsigned char cathodes;
-    
     current_row++;
     current_row &= 0x3;
     // turn off the cathode drivers
-    LATCbits.LATC2 = 1; // OE
-    
-    PIR1bits.SSPIF = 0; // clear the flag ready for next time
-    dummy = SSPBUF; // dummy read needed before next write
-    //SSPCON1bits.WCOL = 0;
-    cathodes = led_matrix[current_row];
-    SSPCON1 = 0x22;
-    PIR1bits.SSPIF = 0; // clear the flag ready for next time
-    SSPBUF = cathodes;
+    BOARD_LED_DISABLE();
     
-//    // wait for data to be sent
-    // This takes quite a bit of time but we have to ensure the cathodes have the
-    // right data before turning on the anodes otherwise we don't get a clean display.
-    while (PIR1bits.SSPIF == 0)
-        ;
+    // the last matrix's cathodes are shifted out first
+#if NUM_MATRICES > 1
+    BOARD_LED_SEND_CATHODES(led_matrix[4 + current_row]);
+#endif
+    BOARD_LED_SEND_CATHODES(led_matrix[current_row]);
 
     // latch the data
-    LATCbits.LATC4 = 1; //LE
-    LATCbits.LATC4 = 0; //LE
+    BOARD_LED_LATCH();
     // turn the relevant anode driver on
-    anodes = ~(1 << 4+current_row);
-    LATB = anodes & 0xf0;
+    BOARD_LED_SELECT_ANODES(anodes[current_row]);
     // turn the relevant cathode driver back on
-    LATCbits.LATC2 = 0; //OE
+    BOARD_LED_ENABLE();
 }
@@ -34,13 +34,15 @@
 extern "C" {
 #endif
 
+#include "candccab.h"
+
     extern void initLeds(void);
     extern void pollLeds(void);
 extern unsigned char testLed(unsigned char no);
 extern void setLed(unsigned char no);
 extern void clearLed(unsigned char no);
 
-extern unsigned char led_matrix[4];
+extern unsigned char led_matrix[4 * NUM_MATRICES];
 
 
 #ifdef	__cplusplus
@@ -69,6 +69,16 @@
 #include "leds.h"
 #include "sections.h"
 #include "tests.h"
+#include "latency.h"
+#include "diagnostics.h"
+#include "cabdccan18.h"
+#include "bulkNv.h"
+#include "ownership.h"
+#include "sync.h"
+#include "bench.h"
+#ifdef FRAME_TRACE
+#include "trace.h"
+#endif
 
 #ifdef NV_CACHE
 #include "nvCache.h"
@@ -88,6 +98,7 @@ void initialise(void);
 void factoryReset(void);
 void factoryResetGlobalNv(void);
 BOOL sendProducedEvent(unsigned char action, BOOL on);
+BOOL isBusReady(void);
 void factoryResetEE(void);
 void factoryResetFlash(void);
 
@@ -145,9 +156,14 @@ TickValue   lastSwitchPollTime;
 TickValue   lastLedPollTime;
 TickValue   lastAnaloguePollTime;
 static TickValue   lastPotentiometerPollTime;
-static TickValue   lastSyncTime;
 TickValue   startTime;
+static TickValue   readyTime;
 static BOOL started;
+static BOOL sodSent;
+WORD timeToReady;   // ms from initialisation until CBUS traffic was allowed
+static TickValue   loadWindowTime;      // start of the current bus load window
+static BYTE loadWindowFrames;           // canRxFrameCount at the start of the window
+static BOOL busLoadLow;                 // the bus load was low in the last window
 static BOOL canInitialised;
 
 #define ANALOGUE_PORT 4
@@ -181,6 +197,8 @@ rom BYTE eeBootFlag = 0;
  */
 #ifdef __18CXX
 void main(void) {
+#elif defined(HOST_BUILD)
+int firmwareMain(void) {    // called by the host build's main(), see host/hostmain.c
 #else
 int main(void) @0x800 {
 #endif
@@ -234,60 +252,115 @@ int main(void) @0x800 {
         if (switch_matrix[2]) {    // second switch on
             test3();
         }
+        if (switch_matrix[3]) {    // third switch on
+            canInit(CBUS_OVER_CAN, 0);
+            canInitialised = TRUE;
+            test4();
+        }
+        if (switch_matrix[4]) {    // fourth switch on
+            test5();
+        }
         test1();
     }
    
     initialise(); 
+#ifdef BENCHMARK
+    runBenchmarks();    // cycle counts are left in benchCycles[], see bench.c
+#endif
  
     started = FALSE;
+    sodSent = FALSE;
+    timeToReady = 0;
     
     startTime.Val = tickGet();
     lastSwitchPollTime.Val = startTime.Val;
     lastLedPollTime.Val = startTime.Val;
     lastAnaloguePollTime.Val = startTime.Val;
     lastPotentiometerPollTime.Val = startTime.Val;
-    lastSyncTime.Val = startTime.Val;
+    loadWindowTime.Val = startTime.Val;
+    loadWindowFrames = canRxFrameCount;
+    busLoadLow = FALSE;
+    initSync();     // so other panels' syncs can be followed whilst we wait to start
 
     while (TRUE) {
-        // Startup delay for CBUS about 2 seconds to let other modules get powered up - ISR will be running so incoming packets processed
-        if (!started && (tickTimeSince(startTime) > (NV->sendSodDelay * HUNDRED_MILI_SECOND) + TWO_SECOND)) {
+        // Hold back CBUS traffic until the bus has settled after power up - ISR will be running so incoming packets processed
+        if (!started && isBusReady()) {
             started = TRUE;
-            if (NV->sendSodDelay > 0) {
-                sendProducedEvent(HAPPENING_SOD, TRUE);
-            }
+            readyTime.Val = tickGet();
+            timeToReady = (WORD)(tickTimeSince(startTime) / ONE_MILI_SECOND);
+            // Restart the master election now we can send, so we listen for 
+            // a whole period before taking over rather than counting the time
+            // spent waiting for the bus to settle.
+            initSync();
+        }
+        if (started && !sodSent && (NV->sendSodDelay > 0) && (tickTimeSince(readyTime) > (NV->sendSodDelay * HUNDRED_MILI_SECOND))) {
+            sodSent = TRUE;
+            sendProducedEvent(HAPPENING_SOD, TRUE);
         }
         checkCBUS();    // Consume any CBUS message and act upon it
         FLiMSWCheck();  // Check FLiM switch for any mode changes
         
+        // The panel itself is serviced straight away
+        if (tickTimeSince(lastAnaloguePollTime) > (6 * ONE_MILI_SECOND)) {
+            pollAnalogue(ANALOGUE_PORT);
+            lastAnaloguePollTime.Val = tickGet();
+        }
+        if (tickTimeSince(lastPotentiometerPollTime) > (19 * ONE_MILI_SECOND)) {
+            pollPotentiometer(started);     // speeds are only sent once we can send CBUS messages
+            lastPotentiometerPollTime.Val = tickGet();
+        }
+        if (tickTimeSince(lastSwitchPollTime) > (2 * ONE_MILI_SECOND)) {
+            pollSwitches(started);  // but button presses are only acted upon once we can tell the other panels
+            lastSwitchPollTime.Val = tickGet();
+        }
+        if (tickTimeSince(lastLedPollTime) > (2 * ONE_MILI_SECOND)) {
+            refreshSectionLeds();
+            pollLeds();
+            lastLedPollTime.Val = tickGet();
+        }
         if (started) {
-            if (tickTimeSince(lastAnaloguePollTime) > (6 * ONE_MILI_SECOND)) {
-                pollAnalogue(ANALOGUE_PORT);
-                lastAnaloguePollTime.Val = tickGet();
-            }
-            if (tickTimeSince(lastPotentiometerPollTime) > (19 * ONE_MILI_SECOND)) {
-                pollPotentiometer();
-                lastPotentiometerPollTime.Val = tickGet();
-            }
-            if (tickTimeSince(lastSwitchPollTime) > (2 * ONE_MILI_SECOND)) {
-                pollSwitches(1);
-                lastSwitchPollTime.Val = tickGet();
-            }
-            if (tickTimeSince(lastLedPollTime) > (2 * ONE_MILI_SECOND)) {
-                pollLeds();
-                lastLedPollTime.Val = tickGet();
-            }
-            if ((NV->sync_tx > 0) && (tickTimeSince(lastSyncTime) > (100 * ONE_MILI_SECOND * NV->sync_tx))) {
-                cbusMsg[d0] = OPC_TON;
-                cbusSendMsg(ALL_CBUS, cbusMsg);     // send a sync 
-                lastSyncTime.Val = tickGet();
-            }
+            pollBulkNv();
+#ifdef FRAME_TRACE
+            pollTrace();
+#endif
+            pollSync();     // send the sync if we are the master
         }
+        pollOwnership(started && (sodSent || (NV->sendSodDelay == 0)));     // save changes and exchange ownership digests
+#ifdef NV_CACHE
+        pollNvCache();  // Write back any changed NVs
+#endif
         // Check for any flashing status LEDs
         checkFlashing();
      } // main loop
 } // main
 
 
+/**
+ * Decide whether the bus has settled enough after power up to start sending.
+ * That is when no CANIDs are being sorted out and the bus load has dropped
+ * below a threshold, or when the maximum startup time has passed. A live
+ * layout is never completely quiet so the load, measured as the frames seen
+ * in each window, is used rather than waiting for silence.
+ * @return TRUE if CBUS traffic can be sent
+ */
+BOOL isBusReady(void) {
+    DWORD maxTime;
+    
+    if (tickTimeSince(loadWindowTime) >= STARTUP_LOAD_WINDOW) {
+        busLoadLow = (BYTE)(canRxFrameCount - loadWindowFrames) < STARTUP_BUSY_FRAMES;
+        loadWindowFrames = canRxFrameCount;
+        loadWindowTime.Val = tickGet();
+    }
+    // 0xFF is the erased value in panels upgraded from before this NV was used
+    maxTime = ((NV->startup_max > 0) && (NV->startup_max != 0xFF)) ? (NV->startup_max * HUNDRED_MILI_SECOND) : TWO_SECOND;
+    if (tickTimeSince(startTime) > maxTime) {
+        return TRUE;
+    }
+    return (!canIdSettling()) 
+            && (tickTimeSince(startTime) > STARTUP_MIN_TIME) 
+            && busLoadLow;
+}
+
 /**
  * The order of initialisation is important.
  */
@@ -302,21 +375,12 @@ void initialise(void) {
         factoryResetFlash();
         // set the reset flag to indicate it has been initialised
         ee_write((WORD)EE_VERSION, EEPROM_VERSION);
-        writeFlashByte((BYTE*)(AT_NV + NV_VERSION), (BYTE)FLASH_VERSION);
-#ifdef NV_CACHE
-        loadNvCache();                
-#endif
     }
     // check if FLASH is valid
     if (NV->nv_version != FLASH_VERSION) {
         // set Flash to default values
+        // this also sets the version number to indicate it has been initialised
         factoryResetFlash();
-        
-         // set the version number to indicate it has been initialised
-        writeFlashByte((BYTE*)(AT_NV + NV_VERSION), (BYTE)FLASH_VERSION);
-#ifdef NV_CACHE
-        loadNvCache();                
-#endif
     }
     initTicker(0);  // set low priority
     // Disable PORT B weak pullups
@@ -333,6 +397,12 @@ void initialise(void) {
     initSwitches();
     initLeds();
     initSections();
+    initOwnership();
+    initLatency();
+    initBulkNv();
+#ifdef FRAME_TRACE
+    initTrace();
+#endif
 
     
     // all init now done, enable interrupts
@@ -347,6 +417,10 @@ void factoryResetEE(void) {
     ee_write((WORD)EE_CAN_ID, DEFAULT_CANID);
     ee_write_short((WORD)EE_NODE_ID, DEFAULT_NN); 
     ee_write((WORD)EE_FLIM_MODE, fsSLiM);
+    ee_write_short((WORD)EE_OP_STATE, 0);
+#if NUM_SECTIONS > 16
+    ee_write_short((WORD)EE_OP_STATE_HIGH, 0);
+#endif
 }
 
 /**
@@ -361,6 +435,9 @@ void factoryReset(void) {
 
 void factoryResetFlash(void) {
     factoryResetGlobalNv();
+#ifdef NV_CACHE
+    flushNvCache();
+#endif
     clearAllEvents();
     factoryResetGlobalEvents();
     flushFlashImage();
@@ -368,10 +445,12 @@ void factoryResetFlash(void) {
 
 /**
  * Check to see if now is a good time to start a flash write.
+ * The processor stalls during the write so avoid doing it whilst messages are
+ * arriving as the receive buffers could overflow.
  * @return 
  */
 unsigned char isSuitableTimeToWriteFlash() {
-    return TRUE;    // we generally don't have anything better to do
+    return tickTimeSince(canLastRxTime) > (20 * ONE_MILI_SECOND);
 }
 
 
@@ -382,18 +461,53 @@ unsigned char isSuitableTimeToWriteFlash() {
  */
 BOOL checkCBUS( void ) {
     BYTE    msg[20];
+    WORD    lookupStart;
+    BOOL    handled;
 
     if (cbusMsgReceived( 0, (BYTE *)msg )) {
         shortFlicker();         // short flicker LED when a CBUS message is seen on the bus
-        if (parseCBUSMsg(msg)) {               // Process the incoming message
+#ifdef FRAME_TRACE
+        traceFrame(msg);
+#endif
+#ifdef NV_CACHE
+        if (parseCachedNvRequest(msg)) {
+            // NV reads and writes are kept away from the library, see nvCache.c
+            longFlicker();
+            return TRUE;
+        }
+#endif
+        lookupStart = canTimestampNow();
+        handled = parseCBUSMsg(msg);    // Process the incoming message
+        if (IS_EVENT_OPC(msg[d0])) {
+            // measure how long the library takes to find and process the event
+            latencyRecord(&eventLookup, canTimestampNow() - lookupStart);
+        }
+        if (handled) {
             longFlicker();      // extend the flicker if we processed the message
             return TRUE;
         }
+        if ((msg[d0] == OPC_ACDAT) && receivedOwnershipDigest(msg)) {
+            // a section ownership message from another panel
+            return TRUE;
+        }
+        if (msg[d0] == OPC_TON) {
+            // another panel's sync
+            syncReceived(msg);
+            return TRUE;
+        }
+        if (msg[d0] == OPC_DTXC) {
+            // long message - may be a bulk NV transfer, answered once we can send
+            if (started) {
+                bulkNvReceive(msg);
+            }
+            return TRUE;
+        }
         if (thisNN(msg)) {
             // handle the CANMIO specifics
             switch (msg[d0]) {
             case OPC_NNRSM: // reset to manufacturer defaults
                 if (flimState == fsFLiMLearn) {
+                    releaseAllControl();    // the section NVs are about to be lost
                     factoryReset();
                 }
                 else 
@@ -402,6 +516,9 @@ BOOL checkCBUS( void ) {
                     cbusSendOpcMyNN( 0, OPC_CMDERR, cbusMsg);
                 }
                 return TRUE;
+            case OPC_RDGN: // read a diagnostic value
+                processDiagnosticRequest(msg);
+                return TRUE;
             case OPC_NNRST: // restart
                 // if we just call main then the stack won't be reset and we'd also want variables to be nullified
                 // instead call the RESET vector (0x0000)
@@ -458,3 +575,4 @@ void ISRHigh(void) {
         
 }
 
+#endif
@@ -51,8 +51,8 @@ extern "C" {
 // BOOTLOADER
 #define BOOTLOADER_PRESENT
 
-// We won't be using event hash tables for fast access - at the expense of some RAM
-//#define HASH_TABLE
+// Use event hash tables for fast access - at the expense of some RAM
+#define HASH_TABLE
 
     
 // enable this for additional validation checks
@@ -60,6 +60,12 @@ extern "C" {
 
 // Whether NVs are cached in RAM
 #define NV_CACHE
+
+// Whether to check the saved CANID is free at startup instead of self enumerating on a clash
+#define CANID_PROBE
+
+// Whether to keep a record of the frames received and switches changed, see trace.h
+#define FRAME_TRACE
     
 // Whether we have default settings useful for testing
 #define TEST_DEFAULT_EVENTS
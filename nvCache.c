@@ -32,21 +32,159 @@
  *
  * Created on 03 June 2016, 08:12
  */
+/**
+ * The cache is also the write back buffer for the NVs. Changes are made to the
+ * cache and the flash blocks which have been changed are marked dirty. Dirty
+ * blocks are written back to flash in one go once the changes have stopped and 
+ * it is a suitable time, so a burst of NV changes costs one erase/write of
+ * each block rather than one per NV.
+ */
 #include "module.h"
 #ifdef NV_CACHE
 #include "cabdcNv.h"
+#include "cabdcEEPROM.h"
+#include "nvCache.h"
 #include "romops.h"
+#include "TickTime.h"
+#include "cbus.h"
+#include "FliM.h"
 static volatile ModuleNvDefs nvCache;        // RAM storage for NVs
+static BYTE nvDirty;                        // one bit for each flash block of NVs which needs writing
+static TickValue nvChangeTime;              // when the first unwritten change was made
+static TickValue nvLastChangeTime;          // when the last change was made
+WORD nvEraseCount;                          // number of flash block erase/writes of the NVs
 
 extern const rom near BYTE * NvBytePtr;
+extern unsigned char isSuitableTimeToWriteFlash(void);
 
+/**
+ * Load the whole cache from flash. This is only needed at power up as after 
+ * that the cache is kept up to date by setNodeVar().
+ * Nothing can be waiting in the flash write image at power up so the NVs are 
+ * streamed straight out of flash with table reads rather than a byte at a time
+ * through readFlashBlock().
+ * @return pointer to the cache
+ */
 ModuleNvDefs* loadNvCache(void) {
     BYTE * np = (BYTE*)(&nvCache);
+    const rom near BYTE * fp = NvBytePtr;
+    unsigned char i;
+    
+    for (i=sizeof(ModuleNvDefs); i>0; i--) {
+        *np++ = *fp++;
+    }
+    nvDirty = 0;
+    nvEraseCount = ee_read_short((WORD)EE_NV_ERASE_COUNT);
+    if (nvEraseCount == 0xFFFF) {
+        nvEraseCount = 0;
+    }
+    return (ModuleNvDefs*)&nvCache;
+}
+
+/**
+ * Read an NV from the cache. The CBUS library's getNodeVar() reads the flash,
+ * which is behind the cache whilst changes are waiting to be written.
+ * @param index the NV index
+ * @return the NV value
+ */
+unsigned int getCachedNodeVar(unsigned int index) {
+    return *((BYTE*)(&nvCache) + index);
+}
+
+/**
+ * Change an NV. The change is made to the cache straight away and written
+ * to flash later by pollNvCache() or flushNvCache().
+ * @param index the NV index
+ * @param value the new value
+ */
+void setCachedNodeVar(unsigned int index, unsigned int value) {
+    BYTE * np = (BYTE*)(&nvCache) + index;
+    
+    if (index >= sizeof(ModuleNvDefs)) return;
+    if (*np == (BYTE)value) return;
+    *np = (BYTE)value;
+    nvLastChangeTime.Val = tickGet();
+    if (nvDirty == 0) {
+        nvChangeTime.Val = nvLastChangeTime.Val;
+    }
+    nvDirty |= 1 << (index / NV_FLASH_BLOCK_SIZE);
+}
+
+/**
+ * Answer an NVSET or NVRD for this module from the cache. These are taken 
+ * before the CBUS library sees them, as its setNodeVar() would write the flash
+ * directly and leave the cache out of date.
+ * @param msg the received message
+ * @return TRUE if the message was an NVSET or NVRD for this module
+ */
+BOOL parseCachedNvRequest(BYTE * msg) {
+    BYTE index;
+    BYTE oldValue;
+
+    if ((msg[d0] != OPC_NVSET) && (msg[d0] != OPC_NVRD)) return FALSE;
+    if ( ! thisNN(msg) || (flimState == fsSLiM)) return FALSE;
+    index = msg[d3];
+    if ((index == 0) || (index >= NV_NUM)) {
+        cbusMsg[d3] = CMDERR_INV_NV_IDX;
+        cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg);
+        return TRUE;
+    }
+    oldValue = (BYTE)getCachedNodeVar(index);
+    if (msg[d0] == OPC_NVSET) {
+        if ( ! validateNV(index, oldValue, msg[d4])) {
+            cbusMsg[d3] = CMDERR_INV_NV_VALUE;
+            cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg);
+            return TRUE;
+        }
+        setCachedNodeVar(index, msg[d4]);
+        actUponNVchange(index, oldValue, msg[d4]);
+        cbusSendOpcMyNN(0, OPC_WRACK, cbusMsg);
+    } else {
+        cbusMsg[d3] = index;
+        cbusMsg[d4] = oldValue;
+        cbusSendOpcMyNN(0, OPC_NVANS, cbusMsg);
+    }
+    return TRUE;
+}
+
+/**
+ * Write all the dirty blocks of NVs to flash now.
+ */
+void flushNvCache(void) {
+    BYTE * np = (BYTE*)(&nvCache);
+    unsigned char block;
     unsigned char i;
-    // do whole blocks
-    for (i=0; i<sizeof(ModuleNvDefs); i++) {
-        *(np+i) = readFlashBlock((WORD)(NvBytePtr+i));
+    unsigned char end;
+    
+    if (nvDirty == 0) return;
+    for (block=0; block < NV_FLASH_BLOCKS; block++) {
+        if (nvDirty & (1 << block)) {
+            end = (block+1) * NV_FLASH_BLOCK_SIZE;
+            if (end > sizeof(ModuleNvDefs)) {
+                end = sizeof(ModuleNvDefs);
+            }
+            // the flash image holds a block at a time so this is one erase/write
+            for (i=block * NV_FLASH_BLOCK_SIZE; i<end; i++) {
+                writeFlashByte((BYTE*)AT_NV + i, *(np+i));
+            }
+            flushFlashImage();
+            nvEraseCount++;
+        }
+    }
+    nvDirty = 0;
+    ee_write_short((WORD)EE_NV_ERASE_COUNT, nvEraseCount);
+}
+
+/**
+ * Call regularly to write back changed NVs once the changes have stopped 
+ * coming and it is a suitable time. They are written anyway if they have been
+ * waiting too long.
+ */
+void pollNvCache(void) {
+    if (nvDirty == 0) return;
+    if (tickTimeSince(nvLastChangeTime) < NV_FLUSH_DELAY) return;
+    if (isSuitableTimeToWriteFlash() || (tickTimeSince(nvChangeTime) > NV_FLUSH_MAX_DELAY)) {
+        flushNvCache();
     }
-    return &nvCache;
 }
 #endif
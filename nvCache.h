@@ -15,7 +15,21 @@ extern "C" {
 #include "module.h"
 #include "cabdcNv.h"
 
+// The NVs occupy this many flash blocks which are erased and written as a whole
+#define NV_FLASH_BLOCK_SIZE     64
+#define NV_FLASH_BLOCKS         ((sizeof(ModuleNvDefs) + NV_FLASH_BLOCK_SIZE - 1) / NV_FLASH_BLOCK_SIZE)
+    
+// Wait for NV changes to stop for this long before writing them to flash
+#define NV_FLUSH_DELAY          ONE_SECOND
+// but don't wait longer than this for a suitable time
+#define NV_FLUSH_MAX_DELAY      (5*ONE_SECOND)
+
 extern ModuleNvDefs * loadNvCache(void);
+extern BOOL parseCachedNvRequest(BYTE * msg);
+extern void flushNvCache(void);
+extern void pollNvCache(void);
+
+extern WORD nvEraseCount;
 
 #ifdef	__cplusplus
 }
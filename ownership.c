@@ -0,0 +1,653 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   ownership.c
+ * Author: Ian
+ * 
+ * Save and restore which sections this panel controls, tell the other panels
+ * about them and keep track of their leases.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "cabdcNv.h"
+#include "cabdcEEPROM.h"
+#include "candccab.h"
+#include "cbus.h"
+#include "sections.h"
+#include "ownership.h"
+#include "cabdccan18.h"
+#include "FliM.h"
+
+static SectionMask savedOwnership;  // what is currently in EEPROM
+static BOOL ownershipDirty;
+static TickValue ownershipChangeTime;
+static BOOL announcePending;       // tell the other panels what we control
+static BOOL rebuildPending;        // ask the other panels what they control
+static BOOL wasBusOff;
+
+/*
+ * Sections we controlled before a power down or bus off. They are only taken
+ * back once the other panels have answered our digest request, and only if 
+ * none of them has said it controls them.
+ */
+static SectionMask restorePending;
+static BOOL restoreWaiting;
+static TickValue restoreTime;
+
+/*
+ * Leases of the sections other panels control. A lease is renewed by any 
+ * message saying the panel still controls the section. Rather than a timer for
+ * each section, time is split into half leases and a section lapses if it 
+ * hasn't been renewed in the current or the previous half.
+ */
+static SectionMask leaseRenewed;            // renewed in this half lease
+static SectionMask leaseRenewedBefore;      // renewed in the previous half
+static TickValue leaseHalfTime;
+static TickValue heartbeatTime;
+WORD leasesExpired;
+
+/*
+ * Take sequence numbers, see ownership.h. takeCount is the latest number seen
+ * for the CAN4DC, kept for each section and the same in all the sections of a
+ * CAN4DC. takeSeq is the number of the take which gave the section to its 
+ * current controller, which decides whether a message about the section is 
+ * newer, older or a tie. Neither is known until a take or digest has been seen.
+ * takeOwner is only needed for a tie between two other panels.
+ */
+static BYTE takeCount[NUM_SECTIONS];
+static SectionMask takeCountKnown;
+static BYTE takeSeq[NUM_SECTIONS];
+static SectionMask takeSeqKnown;
+static WORD takeOwner[NUM_SECTIONS];
+WORD takeTies;
+
+/*
+ * Changes waiting to be acknowledged. Whether a section is being taken or
+ * released is its current state so only the one bitmap is needed. Each 
+ * section keeps its own attempts and backoff so a new change doesn't hold 
+ * back the retries of older ones.
+ */
+static SectionMask ackPending;
+static BYTE ackAttempts[NUM_SECTIONS];
+static TickValue ackTime[NUM_SECTIONS];
+WORD ackFailures;
+
+/*
+ * Other panels' changes we are to acknowledge, unless another panel does 
+ * first.
+ */
+static SectionMask ackDueTake;
+static SectionMask ackDueRelease;
+static TickValue ackDueTime;
+
+static SectionMask readSavedOwnership(void) {
+    WORD w;
+    SectionMask owned = 0;
+    
+    w = ee_read_short((WORD)EE_OP_STATE);
+    if (w != 0xFFFF) {          // never been written
+        owned = w;
+    }
+#if NUM_SECTIONS > 16
+    w = ee_read_short((WORD)EE_OP_STATE_HIGH);
+    if (w != 0xFFFF) {
+        owned |= (SectionMask)w << 16;
+    }
+#endif
+    return owned;
+}
+
+static void writeSavedOwnership(SectionMask owned) {
+    ee_write_short((WORD)EE_OP_STATE, (WORD)owned);
+#if NUM_SECTIONS > 16
+    ee_write_short((WORD)EE_OP_STATE_HIGH, (WORD)(owned >> 16));
+#endif
+}
+
+/**
+ * Read the sections we controlled before we were powered down. Call after 
+ * initSections(). They are restored once the bus has settled and the other
+ * panels have told us which sections they control.
+ */
+void initOwnership(void) {
+    savedOwnership = readSavedOwnership();
+    restorePending = savedOwnership;
+    restoreWaiting = FALSE;
+    ownershipDirty = FALSE;
+    announcePending = FALSE;
+    rebuildPending = TRUE;
+    wasBusOff = FALSE;
+    leaseRenewed = 0;
+    leaseRenewedBefore = 0;
+    leasesExpired = 0;
+    takeCountKnown = 0;
+    takeSeqKnown = 0;
+    takeTies = 0;
+    ackPending = 0;
+    ackFailures = 0;
+    ackDueTake = 0;
+    ackDueRelease = 0;
+    leaseHalfTime.Val = tickGet();
+    heartbeatTime.Val = leaseHalfTime.Val;
+}
+
+/**
+ * Take back the sections we controlled before, except those another panel
+ * has said it controls, and tell the other panels.
+ */
+static void restoreOwnership(void) {
+    unsigned char section;
+    SectionMask restore;
+    
+    restore = restorePending & ~otherControlled;
+    restorePending = 0;
+    for (section=0; restore; section++, restore >>= 1) {
+        if (restore & 1) {
+            restoreOurControl(section);
+        }
+    }
+    ownershipChanged();
+    announcePending = TRUE;
+}
+
+/**
+ * Call whenever the sections we control may have changed.
+ */
+void ownershipChanged(void) {
+    ownershipDirty = TRUE;
+    ownershipChangeTime.Val = tickGet();
+}
+
+/**
+ * Another panel has told us it controls a section.
+ */
+void renewLease(unsigned char section) {
+    leaseRenewed |= SECTION_BIT(section);
+}
+
+/**
+ * Let lapse the sections whose controller hasn't been heard from for a lease
+ * and send our heartbeat.
+ */
+static void pollLeases(void) {
+    DWORD lease;
+    SectionMask lapsed;
+    unsigned char section;
+    
+    if ((NV->lease_time == 0) || (NV->lease_time == 0xFF)) return;
+    lease = (DWORD)NV->lease_time * ONE_SECOND;
+    if (tickTimeSince(leaseHalfTime) > lease/2) {
+        leaseHalfTime.Val = tickGet();
+        lapsed = otherControlled & ~(leaseRenewed | leaseRenewedBefore);
+        leaseRenewedBefore = leaseRenewed;
+        leaseRenewed = 0;
+        for (section=0; lapsed; section++, lapsed >>= 1) {
+            if (lapsed & 1) {
+                forgetOtherControl(section);
+                leasesExpired++;
+            }
+        }
+    }
+    if (ourControlled && (tickTimeSince(heartbeatTime) > lease/OWNERSHIP_RENEWALS)) {
+        announcePending = TRUE;
+    }
+}
+
+static SectionMask sendSections(BYTE type, SectionMask mask, BOOL retry);
+
+/**
+ * @return TRUE if takes and releases are acknowledged, NV ack_attempts
+ */
+BOOL ackMode(void) {
+    return (NV->ack_attempts != 0) && (NV->ack_attempts != 0xFF);
+}
+
+/**
+ * Send the changes which haven't been acknowledged again, or give up on them,
+ * and send our own acknowledgements once no other panel has.
+ */
+static void pollAcks(void) {
+    unsigned char section;
+    SectionMask bit;
+    SectionMask due;
+    
+    if ((ackDueTake || ackDueRelease) && 
+            (tickTimeSince(ackDueTime) > (DWORD)(canID % OWNERSHIP_ACK_SLOTS) * OWNERSHIP_ACK_STAGGER)) {
+        sendSections(OWNERSHIP_ACK | (OWNERSHIP_TAKE << OWNERSHIP_SEQ_SHIFT), ackDueTake, FALSE);
+        sendSections(OWNERSHIP_ACK | (OWNERSHIP_RELEASE << OWNERSHIP_SEQ_SHIFT), ackDueRelease, FALSE);
+        ackDueTake = 0;
+        ackDueRelease = 0;
+    }
+    if ( ! ackPending) return;
+    // another panel has taken it since
+    ackPending &= ~otherControlled;
+    if ( ! ackMode()) {
+        ackPending = 0;
+    }
+    due = 0;
+    for (section=0; section<NUM_SECTIONS; section++) {
+        bit = SECTION_BIT(section);
+        if ( ! (ackPending & bit)) continue;
+        if (tickTimeSince(ackTime[section]) < ((DWORD)OWNERSHIP_ACK_TIMEOUT << 
+                ((ackAttempts[section] < OWNERSHIP_ACK_MAX_BACKOFF) ? ackAttempts[section] : OWNERSHIP_ACK_MAX_BACKOFF))) continue;
+        if (ackAttempts[section]+1 >= NV->ack_attempts) {
+            ackPending &= ~bit;
+            ackFailures++;
+            continue;
+        }
+        ackAttempts[section]++;
+        ackTime[section].Val = tickGet();
+        due |= bit;
+    }
+    sendSections(OWNERSHIP_TAKE, due & ourControlled, TRUE);
+    sendSections(OWNERSHIP_RELEASE, due & ~ourControlled, TRUE);
+}
+
+/**
+ * Call regularly to save changes, to exchange digests with the other panels
+ * and to answer their requests.
+ * @param started TRUE once CBUS messages may be sent and any SoD has been sent
+ */
+void pollOwnership(BOOL started) {
+    SectionMask owned;
+    unsigned char section;
+    
+    if (ownershipDirty && (tickTimeSince(ownershipChangeTime) > OWNERSHIP_SAVE_DELAY)) {
+        ownershipDirty = FALSE;
+        owned = ourControlled | restorePending;
+        if (owned != savedOwnership) {
+            writeSavedOwnership(owned);
+            savedOwnership = owned;
+        }
+    }
+    if ( ! started) return;
+    if (canErrorState == CAN_BUS_OFF) {
+        wasBusOff = TRUE;
+        return;
+    }
+    if (wasBusOff) {
+        // we may have missed changes whilst off the bus, including another 
+        // panel taking our sections
+        wasBusOff = FALSE;
+        rebuildPending = TRUE;
+        restorePending |= ourControlled;
+        for (section=0; section<NUM_SECTIONS; section++) {
+            forgetOurControl(section);
+        }
+    }
+    if (rebuildPending) {
+        rebuildPending = FALSE;
+        requestOwnershipDigests();
+        restoreWaiting = TRUE;
+        restoreTime.Val = tickGet();
+    }
+    if (restoreWaiting && (tickTimeSince(restoreTime) > OWNERSHIP_RESTORE_WAIT)) {
+        restoreWaiting = FALSE;
+        restoreOwnership();
+    }
+    pollLeases();
+    pollAcks();
+    if (announcePending) {
+        announcePending = FALSE;
+        announceOwnership();
+    }
+}
+
+/**
+ * Forget which sections the other panels control and ask them all to tell us.
+ */
+void requestOwnershipDigests(void) {
+    unsigned char section;
+    
+    for (section=0; section<NUM_SECTIONS; section++) {
+        forgetOtherControl(section);
+    }
+    cbusMsg[d3] = OWNERSHIP_SIGNATURE;
+    cbusMsg[d4] = OWNERSHIP_DIGEST_REQUEST;
+    cbusMsg[d5] = 0;
+    cbusMsg[d6] = 0;
+    cbusMsg[d7] = 0;
+    cbusSendOpcMyNN(0, OPC_ACDAT, cbusMsg);
+}
+
+/**
+ * Send an ACDAT for each bank of ENs which has any set.
+ * @param typeSeq the type byte without the bank bit
+ * @param nnh the CAN4DC node number
+ * @param nnl
+ * @param ens bitmap of the ENs
+ */
+static void sendOwnership(BYTE typeSeq, BYTE nnh, BYTE nnl, WORD ens) {
+    cbusMsg[d3] = OWNERSHIP_SIGNATURE;
+    cbusMsg[d5] = nnh;
+    cbusMsg[d6] = nnl;
+    if (ens & 0xFF) {
+        cbusMsg[d4] = typeSeq;
+        cbusMsg[d7] = ens & 0xFF;
+        cbusSendOpcMyNN(0, OPC_ACDAT, cbusMsg);
+    }
+    if (ens >> 8) {
+        cbusMsg[d4] = typeSeq | OWNERSHIP_BANK;
+        cbusMsg[d7] = ens >> 8;
+        cbusSendOpcMyNN(0, OPC_ACDAT, cbusMsg);
+    }
+}
+
+/**
+ * @return TRUE if the section is on the CAN4DC and its EN is in the bitmap
+ */
+static BOOL sectionListed(unsigned char section, BYTE nnh, BYTE nnl, WORD ens) {
+    if (NV->sections[section].section_nn_bytes.section_nn_h != nnh) return FALSE;
+    if (NV->sections[section].section_nn_bytes.section_nn_l != nnl) return FALSE;
+    if (NV->sections[section].section_en_bytes.section_en_h != 0) return FALSE;
+    if (NV->sections[section].section_en_bytes.section_en_l > 15) return FALSE;
+    return (ens & ((WORD)1 << NV->sections[section].section_en_bytes.section_en_l)) != 0;
+}
+
+/**
+ * Compare two take sequence numbers. They wrap, so the later of two is the one
+ * up to half way round ahead of the other.
+ * @return 1 if a is later than b, 0 if they are the same and -1 if it is earlier
+ */
+static signed char seqCompare(BYTE a, BYTE b) {
+    BYTE diff;
+    
+    diff = (a - b) & OWNERSHIP_SEQ_MASK;
+    if (diff == 0) return 0;
+    return (diff < (OWNERSHIP_SEQ_MASK+1)/2) ? 1 : -1;
+}
+
+/**
+ * Record the take count of a CAN4DC from a take or digest.
+ * @param nnh the CAN4DC node number
+ * @param nnl
+ * @param seq the sequence number in the message
+ */
+static void noteCount(BYTE nnh, BYTE nnl, BYTE seq) {
+    unsigned char section;
+    
+    for (section=0; section<NUM_SECTIONS; section++) {
+        if (NV->sections[section].section_nn_bytes.section_nn_h != nnh) continue;
+        if (NV->sections[section].section_nn_bytes.section_nn_l != nnl) continue;
+        if ( ! (takeCountKnown & SECTION_BIT(section)) || (seqCompare(seq, takeCount[section]) > 0)) {
+            takeCount[section] = seq;
+            takeCountKnown |= SECTION_BIT(section);
+        }
+    }
+}
+
+/**
+ * Record a take of the sections of a CAN4DC listed in ens. Sections taken 
+ * since by a later take keep that take's number.
+ * @param nnh the CAN4DC node number
+ * @param nnl
+ * @param seq the take sequence number
+ * @param ens bitmap of the ENs taken
+ */
+static void noteTake(BYTE nnh, BYTE nnl, BYTE seq, WORD ens) {
+    unsigned char section;
+    
+    noteCount(nnh, nnl, seq);
+    for (section=0; section<NUM_SECTIONS; section++) {
+        if ( ! sectionListed(section, nnh, nnl, ens)) continue;
+        if ((takeSeqKnown & SECTION_BIT(section)) && (seqCompare(seq, takeSeq[section]) < 0)) continue;
+        takeSeq[section] = seq;
+        takeSeqKnown |= SECTION_BIT(section);
+    }
+}
+
+/**
+ * A section has become uncontrolled, so the take which gave it to its last 
+ * controller no longer decides anything about it. Whichever panel takes it 
+ * next may not have seen that take, for example because it has just started.
+ */
+void forgetTakeSeq(unsigned char section) {
+    takeSeqKnown &= ~SECTION_BIT(section);
+}
+
+/**
+ * Decide whether a take or digest from another panel is about the section's 
+ * current controller. One sent before the take which gave the section to its
+ * controller is ignored, a later one wins and one with the same number is a 
+ * tie.
+ * @param section
+ * @param seq the sequence number in the message
+ * @param sender the node number of the panel which sent it
+ * @return FALSE if the message is to be ignored for this section
+ */
+static BOOL winsTie(unsigned char section, BYTE seq, WORD sender) {
+    SectionMask bit = SECTION_BIT(section);
+    signed char order;
+    
+    if ( ! (takeSeqKnown & bit)) return TRUE;
+    order = seqCompare(seq, takeSeq[section]);
+    if (order < 0) return FALSE;
+    if (order > 0) return TRUE;
+    if (ourControlled & bit) {
+        takeTies++;
+        if (sender < nodeID) return TRUE;
+        // make sure the other panel hears that we kept it
+        announcePending = TRUE;
+        return FALSE;
+    }
+    if (otherControlled & bit) {
+        if (sender == takeOwner[section]) return TRUE;   // the same take again
+        takeTies++;
+        return sender < takeOwner[section];
+    }
+    return TRUE;
+}
+
+/**
+ * Handle an ACDAT from another panel. A digest or take marks each of our 
+ * sections which it lists as controlled by that panel, unless it loses a tie,
+ * and a release marks them as uncontrolled. A request is answered from
+ * pollOwnership(). An acknowledgement clears the sections it lists from those
+ * waiting for one. ACDATs without the signature, or with a type we don't know,
+ * are from other modules and are left alone.
+ * @param msg the ACDAT message
+ * @return TRUE if it was an ownership message
+ */
+BOOL receivedOwnershipDigest(BYTE * msg) {
+    unsigned char section;
+    WORD ens;
+    WORD sender;
+    BYTE type;
+    BYTE seq;
+    SectionMask listed;
+    
+    if ((msg[dlc] & 0x0F) != 8) return FALSE;
+    if (msg[d3] != OWNERSHIP_SIGNATURE) return FALSE;
+    type = msg[d4] & OWNERSHIP_TYPE_MASK;
+    seq = msg[d4] >> OWNERSHIP_SEQ_SHIFT;
+    ens = msg[d7];
+    if (msg[d4] & OWNERSHIP_BANK) {
+        ens <<= 8;
+    }
+    switch (type) {
+        case OWNERSHIP_DIGEST_REQUEST:
+            announcePending = TRUE;
+            // the panel has restarted or come back from bus off and counts 
+            // the takes from the start again
+            sender = ((WORD)msg[d1] << 8) | msg[d2];
+            takeCountKnown = 0;
+            for (section=0; section<NUM_SECTIONS; section++) {
+                if ((otherControlled & SECTION_BIT(section)) && (takeOwner[section] == sender)) {
+                    forgetTakeSeq(section);
+                }
+            }
+            break;
+        case OWNERSHIP_ACK:
+            // seq is the type acknowledged
+            for (section=0; section<NUM_SECTIONS; section++) {
+                if ( ! sectionListed(section, msg[d5], msg[d6], ens)) continue;
+                // another panel has acknowledged it so we needn't
+                if (seq == OWNERSHIP_TAKE) {
+                    ackDueTake &= ~SECTION_BIT(section);
+                } else {
+                    ackDueRelease &= ~SECTION_BIT(section);
+                }
+                if ( ! (ackPending & SECTION_BIT(section))) continue;
+                if ((seq == OWNERSHIP_TAKE) == ((ourControlled & SECTION_BIT(section)) != 0)) {
+                    ackPending &= ~SECTION_BIT(section);
+                }
+            }
+            break;
+        case OWNERSHIP_DIGEST:
+        case OWNERSHIP_TAKE:
+        case OWNERSHIP_RELEASE:
+            sender = ((WORD)msg[d1] << 8) | msg[d2];
+            listed = 0;
+            for (section=0; section<NUM_SECTIONS; section++) {
+                if ( ! sectionListed(section, msg[d5], msg[d6], ens)) continue;
+                listed |= SECTION_BIT(section);
+                if (type == OWNERSHIP_RELEASE) {
+                    lostOtherControlledMessage(section);
+                } else if (winsTie(section, seq, sender)) {
+                    takeOwner[section] = sender;
+                    gotOtherControlledMessage(section);
+                }
+            }
+            if (type == OWNERSHIP_TAKE) {
+                noteTake(msg[d5], msg[d6], seq, ens);
+            } else if (type == OWNERSHIP_DIGEST) {
+                noteCount(msg[d5], msg[d6], seq);
+            }
+            if (listed && (type != OWNERSHIP_DIGEST) && ackMode()) {
+                // acknowledged after a delay set by our CANID, and only if no 
+                // other panel with the sections does so first
+                if ( ! (ackDueTake || ackDueRelease)) {
+                    ackDueTime.Val = tickGet();
+                }
+                if (type == OWNERSHIP_TAKE) {
+                    ackDueTake |= listed;
+                } else {
+                    ackDueRelease |= listed;
+                }
+            }
+            break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Tell the other panels which sections we control.
+ */
+void announceOwnership(void) {
+    unsigned char section;
+    SectionMask leftover;
+    
+    heartbeatTime.Val = tickGet();
+    leftover = sendSectionDigests(OWNERSHIP_DIGEST, ourControlled);
+    for (section=0; leftover; section++, leftover >>= 1) {
+        if (leftover & 1) {
+            requestControl(section);
+        }
+    }
+}
+
+/**
+ * Send ACDATs listing a set of sections, one for each CAN4DC and bank of ENs.
+ * @param type OWNERSHIP_DIGEST, OWNERSHIP_TAKE, OWNERSHIP_RELEASE or 
+ * OWNERSHIP_ACK with the type acknowledged in the high nibble
+ * @param mask the sections to send
+ * @param retry TRUE if a take or release is being sent again
+ * @return the sections which couldn't be sent because their EN is above 15
+ */
+static SectionMask sendSections(BYTE type, SectionMask mask, BOOL retry) {
+    unsigned char section;
+    unsigned char s;
+    SectionMask leftover = 0;
+    WORD ens;
+    BYTE nnh, nnl;
+    BYTE seq;
+    
+    for (section=0; section<NUM_SECTIONS; section++) {
+        if ( ! (mask & SECTION_BIT(section))) continue;
+        nnh = NV->sections[section].section_nn_bytes.section_nn_h;
+        nnl = NV->sections[section].section_nn_bytes.section_nn_l;
+        if ((NV->sections[section].section_en_bytes.section_en_h != 0) || 
+                (NV->sections[section].section_en_bytes.section_en_l > 15)) {
+            // doesn't fit in the digest
+            leftover |= SECTION_BIT(section);
+            continue;
+        }
+        seq = 0;
+        if (type == OWNERSHIP_TAKE) {
+            // a retry keeps the number of the take
+            seq = retry ? takeSeq[section] : ((takeCount[section] + 1) & OWNERSHIP_SEQ_MASK);
+        } else if (type == OWNERSHIP_DIGEST) {
+            seq = takeCount[section];
+        }
+        if ((type == OWNERSHIP_TAKE) && ! retry) {
+            // the count may have been learnt from a panel which has just 
+            // started, so make sure the take is later than those it replaces
+            for (s=section; s<NUM_SECTIONS; s++) {
+                if ( ! (mask & takeSeqKnown & SECTION_BIT(s))) continue;
+                if (NV->sections[s].section_nn_bytes.section_nn_h != nnh) continue;
+                if (NV->sections[s].section_nn_bytes.section_nn_l != nnl) continue;
+                if (seqCompare(seq, takeSeq[s]) <= 0) {
+                    seq = (takeSeq[s] + 1) & OWNERSHIP_SEQ_MASK;
+                }
+            }
+        }
+        // collect all the sections on this CAN4DC
+        ens = 0;
+        for (s=section; s<NUM_SECTIONS; s++) {
+            if ( ! (mask & SECTION_BIT(s))) continue;
+            if (NV->sections[s].section_nn_bytes.section_nn_h != nnh) continue;
+            if (NV->sections[s].section_nn_bytes.section_nn_l != nnl) continue;
+            if (NV->sections[s].section_en_bytes.section_en_h != 0) continue;
+            if (NV->sections[s].section_en_bytes.section_en_l > 15) continue;
+            if (retry && (type == OWNERSHIP_TAKE) && (takeSeq[s] != seq)) continue;
+            ens |= (WORD)1 << NV->sections[s].section_en_bytes.section_en_l;
+            mask &= ~SECTION_BIT(s);
+            if (((type == OWNERSHIP_TAKE) || (type == OWNERSHIP_RELEASE)) && ! retry && ackMode()) {
+                ackPending |= SECTION_BIT(s);
+                ackAttempts[s] = 0;
+                ackTime[s].Val = tickGet();
+            }
+        }
+        if ((type == OWNERSHIP_TAKE) && ! retry) {
+            noteTake(nnh, nnl, seq, ens);
+        }
+        sendOwnership(type | (seq << OWNERSHIP_SEQ_SHIFT), nnh, nnl, ens);
+    }
+    return leftover;
+}
+
+/**
+ * Send ACDATs listing a set of sections, one for each CAN4DC and bank of ENs. With NV
+ * ack_attempts set a take or release is sent again until it is acknowledged.
+ * @param type OWNERSHIP_DIGEST, OWNERSHIP_TAKE or OWNERSHIP_RELEASE
+ * @param mask the sections to send
+ * @return the sections which couldn't be sent because their EN is above 15
+ */
+SectionMask sendSectionDigests(BYTE type, SectionMask mask) {
+    return sendSections(type, mask, FALSE);
+}
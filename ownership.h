@@ -0,0 +1,157 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   ownership.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef OWNERSHIP_H
+#define	OWNERSHIP_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "TickTime.h"
+#include "candccab.h"
+
+/*
+ * The sections we control are saved in EEPROM so that they can be restored
+ * after a power blip. Changes are only written once they have stopped for
+ * OWNERSHIP_SAVE_DELAY so rapid changes don't wear out the EEPROM.
+ */
+#define OWNERSHIP_SAVE_DELAY    (2*ONE_SECOND)
+
+/*
+ * After power up or bus off the saved sections are only taken back once the 
+ * other panels have had this long to answer our digest request.
+ */
+#define OWNERSHIP_RESTORE_WAIT  (5*HUNDRED_MILI_SECOND)
+
+/*
+ * Ownership is announced with one ACDAT for each CAN4DC rather than an ASON3 
+ * for each section:
+ *   ACDAT <our NN hi> <our NN lo> OWNERSHIP_SIGNATURE <type> <CAN4DC NN hi> <CAN4DC NN lo> <ENs>
+ * with type OWNERSHIP_DIGEST and a bit set for each EN of that CAN4DC which we
+ * control. The ENs byte covers ENs 0-7, or ENs 8-15 if OWNERSHIP_BANK is set 
+ * in the type byte, so a CAN4DC with sections in both needs two ACDATs.
+ * Sections with an EN above 15 are announced with an ASON3 instead.
+ * ACDAT is also used by other modules for their own data, so an ACDAT without
+ * OWNERSHIP_SIGNATURE, or with a type not listed here, is ignored.
+ * 
+ * A group of sections is taken or released in the same way using 
+ * OWNERSHIP_TAKE or OWNERSHIP_RELEASE as the type. A single section is taken
+ * with an ASON3 and released with an ASOF3. With NV_FLAG_TAKE_SEQUENCE or NV
+ * ack_attempts set it is also taken or released in this way, unless its EN is
+ * above 15, and with NV_FLAG_TAKE_SEQUENCE set the panels then ignore the 
+ * ASON3/ASOF3 for it.
+ * 
+ * The type is in the low 3 bits of the type byte. The high nibble of a take 
+ * carries a sequence number so that two panels taking the same section at 
+ * the same time end up agreeing which of them has it. Each panel counts the 
+ * takes it sees for each CAN4DC and sends the next number with its own take.
+ * A take which another panel sent before it saw ours has the same number as
+ * ours, which makes it a tie. Every panel resolves a tie the same way, in 
+ * favour of the panel with the lower node number, so the panels agree once
+ * both takes have been seen and no retries are needed. Digests carry the 
+ * panel's count for the CAN4DC, so a digest sent during a tie is resolved in
+ * the same way. A panel which keeps a section in a tie announces it again, in
+ * case the other panel's number was only the same by chance.
+ * 
+ * The numbers wrap, so they are compared as serial numbers, the later of two 
+ * being the one up to half way round ahead. Each panel remembers the number of
+ * the take which gave each section to its controller. A take or digest with a
+ * later number wins, and one with an earlier number was sent before that take
+ * had been seen, so it is ignored for that section. The number is forgotten 
+ * when the section becomes uncontrolled, by a release, a lapsed lease or a 
+ * restart or bus off, as the next panel to take it may be one which has just
+ * started counting again. A panel's digest request says it has done so, so the
+ * others forget the numbers of the sections it controls and their counts, and 
+ * a take is always sent later than the takes of the sections it replaces.
+ * 
+ * A panel which has just started, or has come back from bus off, forgets which
+ * sections other panels control and asks them all to announce theirs with:
+ *   ACDAT <our NN hi> <our NN lo> OWNERSHIP_SIGNATURE OWNERSHIP_DIGEST_REQUEST 0 0 0
+ * 
+ * With NV ack_attempts set, every take or release is also sent as an ACDAT,
+ * whether or not NV_FLAG_TAKE_SEQUENCE is set, and is acknowledged with
+ *   ACDAT <our NN hi> <our NN lo> OWNERSHIP_SIGNATURE OWNERSHIP_ACK <CAN4DC NN hi> <CAN4DC NN lo> <ENs>
+ * with the type acknowledged in the high nibble, listing the sections of the 
+ * change which the panel has. Only the panels which have sections of the 
+ * change are affected by it and only one of them needs to answer, so each 
+ * waits OWNERSHIP_ACK_STAGGER for each step of its CANID, modulo 
+ * OWNERSHIP_ACK_SLOTS, and doesn't answer for the sections another panel has
+ * acknowledged by then. The panel which sent the change 
+ * sends it again, after OWNERSHIP_ACK_TIMEOUT doubled for each attempt, until
+ * it is acknowledged or it has been sent ack_attempts times. Each section 
+ * keeps its own attempts and backoff. A retried take keeps its sequence 
+ * number. ack_attempts should be the same on all the panels.
+ * 
+ * With NV lease_time set, control is a lease. Each panel announces its digests
+ * again every lease_time/OWNERSHIP_RENEWALS as a heartbeat, and a section which
+ * another panel has not mentioned for lease_time is taken to be uncontrolled,
+ * so the sections of a panel which has been switched off or unplugged become 
+ * free. lease_time should be the same on all the panels.
+ */
+#define OWNERSHIP_DIGEST            1
+#define OWNERSHIP_DIGEST_REQUEST    2
+#define OWNERSHIP_TAKE              3
+#define OWNERSHIP_RELEASE           4
+#define OWNERSHIP_ACK               5
+
+#define OWNERSHIP_SIGNATURE         0xCD
+#define OWNERSHIP_TYPE_MASK         0x07
+#define OWNERSHIP_BANK              0x08    // the ENs byte is ENs 8-15
+#define OWNERSHIP_SEQ_SHIFT         4
+#define OWNERSHIP_SEQ_MASK          0x0F
+
+#define OWNERSHIP_RENEWALS          3   // heartbeats in each lease so one or two may be lost
+#define OWNERSHIP_ACK_TIMEOUT       HUNDRED_MILI_SECOND
+#define OWNERSHIP_ACK_MAX_BACKOFF   5   // the timeout stops doubling after this many attempts
+#define OWNERSHIP_ACK_STAGGER       (2*ONE_MILI_SECOND)    // for each CANID, longer than a frame takes to be heard
+#define OWNERSHIP_ACK_SLOTS         32  // CANIDs share the delays so all are within the first timeout
+
+extern void initOwnership(void);
+extern void ownershipChanged(void);
+extern void pollOwnership(BOOL started);
+extern void announceOwnership(void);
+extern SectionMask sendSectionDigests(BYTE type, SectionMask mask);
+extern BOOL ackMode(void);
+extern void requestOwnershipDigests(void);
+extern BOOL receivedOwnershipDigest(BYTE * msg);
+extern void renewLease(unsigned char section);
+extern void forgetTakeSeq(unsigned char section);
+
+extern WORD leasesExpired;
+extern WORD takeTies;
+extern WORD ackFailures;
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* OWNERSHIP_H */
+
@@ -37,6 +37,8 @@
 
 unsigned char previousReading;
 char previousSpeed;
+static char speedTable[129];    // speed for each distance of the reading from the centre
+static BOOL speedTableValid;
 
 // Forward declarations
 void setSpeed(unsigned char section, char speed);
@@ -48,6 +50,14 @@ void setAllSpeed(char speed);
 void initPotentiometer() {
     previousReading = lastReading;
     previousSpeed = 0;
+    speedTableValid = FALSE;
+}
+
+/**
+ * The pot NVs have changed so the speed table needs to be worked out again.
+ */
+void invalidateSpeedTable(void) {
+    speedTableValid = FALSE;
 }
 
 int abs(int a) {
@@ -57,6 +67,27 @@ int sgn(int a) {
     return (a < 0) ? -1 : 1; 
 }
 
+/**
+ * Work out the speed for each distance of the reading from the centre.
+ */
+static void buildSpeedTable(void) {
+    unsigned char i;
+    int r;
+    
+    for (i=0; i<sizeof(speedTable); i++) {
+        if (i < NV->pot_dead_zone) {
+            speedTable[i] = 0;
+            continue;
+        }
+        // now the linear bit
+        // (127-A)speed =  (reading-A)(C-B) + (127-A)B
+        r = i - NV->pot_dead_zone;
+        r *= (NV->pot_end_level - NV->pot_start_level);
+        speedTable[i] = NV->pot_start_level + r/(128 - NV->pot_dead_zone);
+    }
+    speedTableValid = TRUE;
+}
+
 /**
  * Convert a reading to a speed value.
  * 
@@ -89,26 +120,30 @@ int sgn(int a) {
  */
 char speed(unsigned char reading) {
     int r = reading-128;
-    char sign;
-    if (abs(r) < NV->pot_dead_zone) return 0;
     
-    // now the linear bit
-    sign = sgn(r);
-    // (127-A)speed =  (reading-A)(C-B) + (127-A)B
-//    signedReading -= NV->pot_dead_zone;
-    r = abs(r) - NV->pot_dead_zone;
-    r *= (NV->pot_end_level - NV->pot_start_level);
-    r = NV->pot_start_level + r/(128 - NV->pot_dead_zone);
-    return sign*r;
+    if ( ! speedTableValid) {
+        buildSpeedTable();
+    }
+    return sgn(r)*speedTable[abs(r)];
 }
 
 /** 
  * Call this regularly at the maximum rate of transmitting the speed changes.
  * You also need to call pollAnalogue() to ensure you get a recent pot setting
+ * Changes no bigger than pot_hysteresis are ignored as ADC noise, except at
+ * the ends of the track so that full speed can always be reached.
+ * @param started TRUE once CBUS messages may be sent. Until then the pot is 
+ * left alone so that the speed it is set to is sent once they may.
  */
-void pollPotentiometer(void) {
+void pollPotentiometer(BOOL started) {
     char currentSpeed;
-    if (previousReading != lastReading) {
+    unsigned char change;
+    unsigned char hysteresis;
+    
+    if ( ! started) return;
+    hysteresis = (NV->pot_hysteresis == 0xFF) ? 0 : NV->pot_hysteresis;
+    change = (lastReading > previousReading) ? (lastReading - previousReading) : (previousReading - lastReading);
+    if ((change > hysteresis) || ((change != 0) && ((lastReading == 0) || (lastReading == 255)))) {
         // pot has changed
         previousReading = lastReading;
         
@@ -122,9 +157,11 @@ void pollPotentiometer(void) {
 
 void setAllSpeed(char speed) {
     unsigned char i;
+    SectionMask owned = ourControlled;
     
-    for (i=0; i<NUM_SECTIONS; i++) {
-        if (testLed(sections[i].ourControl_led)) {
+    // only look at the sections we control
+    for (i=0; owned; i++, owned >>= 1) {
+        if (owned & 1) {
             if (getSwitchState(sections[i].direction_switch)) {
                 setSpeed(i, -speed);
             } else {
@@ -33,10 +33,13 @@
 #ifdef	__cplusplus
 extern "C" {
 #endif
+
+#include "GenericTypeDefs.h"
     
     extern void initPotentiometer(void);
-    extern void pollPotentiometer(void);
+    extern void pollPotentiometer(BOOL started);
     extern void setSpeed(unsigned char section, char speed);
+    extern void invalidateSpeedTable(void);
 
 #ifdef	__cplusplus
 }
@@ -35,6 +35,9 @@
 #include "cabdcNv.h"
 #include "FliM.h"
 #include "nvCache.h"
+#include "ownership.h"
+#include "board.h"
+#include "trace.h"
 
 /* 
  * File:   sections.c
@@ -59,118 +62,133 @@
  *  controlled=true
  *
  * 
- * Use the LEDs to store state:
- * LEDs:
- * have control controlled  meaning
- *  0           0           Section is off, uncontrolled
- *  0           1           Some other panel is controlling this section
- *  1           0           unused
- *  1           1           This panel is controlling this section
+ * The state is held in two bitmaps with a bit for each section:
+ * ourControlled otherControlled  meaning
+ *  0             0               Section is uncontrolled
+ *  0             1               Some other panel is controlling this section
+ *  1             0               This panel is controlling this section
+ *  1             1               unused
+ * and is shown on the LEDs by refreshSectionLeds().
  */
 
 // The LEDs and Switches are numbered in different ways
 
 // request_switch, release_switch, haveControl_led, controlled_led
 
-Section sections[NUM_SECTIONS]; 
-static unsigned char switch2Section[NUM_SWITCHES];
+// The switches and LEDs of each section are fixed by the board so are held in ROM.
+// See the board description header selected by board.h.
+const rom Section sections[NUM_SECTIONS] = { BOARD_SECTIONS }; 
+static const rom unsigned char switch2Section[NUM_SWITCHES] = { BOARD_SWITCH_SECTIONS };
+static SectionMask configuredSections;         // one bit for each section which has a node number
+SectionMask ourControlled;                   // one bit for each section this panel controls
+SectionMask otherControlled;                 // one bit for each section another panel controls
+static BOOL sectionLedsStale;
+
+static void groupSwitchPressed(unsigned char group);
+static void sendControlEvent(unsigned char section, BOOL on);
+static BOOL sectionLookupValid;
 
 /**
  * 
  */
 void initSections(void) {
-    unsigned char i;
-/*   
-    sections[0].request_switch = 0;
-    sections[0].release_switch = 16;
-    sections[0].controlled_led = 0;
-    sections[0].haveControl_led = 8;
-    
-    sections[1].request_switch = 1;
-    sections[1].release_switch = 17;
-    sections[1].controlled_led = 1;
-    sections[1].haveControl_led = 9;
-   
-    sections[2].request_switch = 2;
-    sections[2].release_switch = 18;
-    sections[2].controlled_led = 2;
-    sections[2].haveControl_led = 10;
-    
-    sections[3].request_switch = 3;
-    sections[3].release_switch = 19;
-    sections[3].controlled_led = 3;
-    sections[3].haveControl_led = 11;
-    
-    sections[4].request_switch = 4;
-    sections[4].release_switch = 20;
-    sections[4].controlled_led = 4;
-    sections[4].haveControl_led = 12;
-    
-    sections[5].request_switch = 5;
-    sections[5].release_switch = 21;
-    sections[5].controlled_led = 5;
-    sections[5].haveControl_led = 13;
-    
-    sections[6].request_switch = 6;
-    sections[6].release_switch = 22;
-    sections[6].controlled_led = 6;
-    sections[6].haveControl_led = 14;
-    
-    sections[7].request_switch = 7;
-    sections[7].release_switch = 23;
-    sections[7].controlled_led = 7;
-    sections[7].haveControl_led = 15;
-    
-    sections[8].request_switch = 8;
-    sections[8].release_switch = 24;
-    sections[8].controlled_led = 16;
-    sections[8].haveControl_led = 24;
-    
-    sections[9].request_switch = 9;
-    sections[9].release_switch = 25;
-    sections[9].controlled_led = 17;
-    sections[9].haveControl_led = 25;
-    
-    sections[10].request_switch = 10;
-    sections[10].release_switch = 26;
-    sections[10].controlled_led = 18;
-    sections[10].haveControl_led = 26;
+    sectionLookupValid = FALSE;
+    ourControlled = 0;
+    otherControlled = 0;
+    sectionLedsStale = TRUE;
+}
+
+/**
+ * Change the state of a section.
+ */
+static void setSectionState(unsigned char section, BOOL ours, BOOL other) {
+    SectionMask bit = SECTION_BIT(section);
     
-    sections[11].request_switch = 11;
-    sections[11].release_switch = 27;
-    sections[11].controlled_led = 19;
-    sections[11].haveControl_led = 27;
+    if (ours) {
+        ourControlled |= bit;
+    } else {
+        ourControlled &= ~bit;
+    }
+    if (other) {
+        otherControlled |= bit;
+    } else {
+        otherControlled &= ~bit;
+    }
+    if ( ! ours && ! other) {
+        forgetTakeSeq(section);
+    }
+    sectionLedsStale = TRUE;
+}
+
+/**
+ * Show the section state on the LEDs. Call before pollLeds().
+ */
+void refreshSectionLeds(void) {
+    unsigned char section;
+    SectionMask bit = 1;
     
-    sections[12].request_switch = 12;
-    sections[12].release_switch = 28;
-    sections[12].controlled_led = 20;
-    sections[12].haveControl_led = 28;
+    if ( ! sectionLedsStale) return;
+    sectionLedsStale = FALSE;
+    for (section=0; section<NUM_SECTIONS; section++, bit <<= 1) {
+        if (ourControlled & bit) {
+            setLed(sections[section].ourControl_led);
+        } else {
+            clearLed(sections[section].ourControl_led);
+        }
+        if (otherControlled & bit) {
+            setLed(sections[section].otherControlled_led);
+        } else {
+            clearLed(sections[section].otherControlled_led);
+        }
+    }
+}
+
+/**
+ * @return the number of sections this panel controls
+ */
+unsigned char countOurControlled(void) {
+    SectionMask owned = ourControlled;
+    unsigned char count = 0;
     
-    sections[13].request_switch = 13;
-    sections[13].release_switch = 29;
-    sections[13].controlled_led = 21;
-    sections[13].haveControl_led = 29;
+    while (owned) {
+        owned &= owned - 1;     // clear the lowest set bit
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Release every section this panel controls.
+ */
+void releaseAllControl(void) {
+    unsigned char section;
+    SectionMask owned = ourControlled;
     
-    sections[14].request_switch = 14;
-    sections[14].release_switch = 30;
-    sections[14].controlled_led = 22;
-    sections[14].haveControl_led = 30;
+    for (section=0; owned; section++, owned >>= 1) {
+        if (owned & 1) {
+            releaseControl(section);
+        }
+    }
+}
+
+/**
+ * The section NVs have changed so the lookup needs to be worked out again.
+ */
+void invalidateSectionLookup(void) {
+    sectionLookupValid = FALSE;
+}
+
+static void buildSectionLookup(void) {
+    unsigned char section;
     
-    sections[15].request_switch = 15;
-    sections[15].release_switch = 31;
-    sections[15].controlled_led = 23;
-    sections[15].haveControl_led = 31;
-*/
-      
-    // fill in the switch2Section lookup table
-    for (i=0; i<NUM_SECTIONS; i++){
-        sections[i].request_switch = i;
-        sections[i].direction_switch = (i+16);
-        sections[i].otherControlled_led = i+(i/8)*8;
-        sections[i].ourControl_led = 8+i+(i/8)*8;
-        switch2Section[sections[i].request_switch] = i;
-        switch2Section[sections[i].direction_switch] = i;
+    configuredSections = 0;
+    for (section = 0; section <NUM_SECTIONS; section++) {
+        if ((NV->sections[section].section_nn_bytes.section_nn_h != 0) || 
+                (NV->sections[section].section_nn_bytes.section_nn_l != 0)) {
+            configuredSections |= SECTION_BIT(section);
+        }
     }
+    sectionLookupValid = TRUE;
 }
 
 /**
@@ -182,12 +200,23 @@ void initSections(void) {
  */
 void switch_pressed(unsigned char sw, unsigned char state) {
     unsigned char section;
+    unsigned char group;
     
+#ifdef FRAME_TRACE
+    traceSwitch(sw, state);
+#endif
     if (state == 0) {
         // we are only interested in switch presses
         return;
     }
     if (sw > NUM_SWITCHES) return;
+    // group switches take priority over their normal use
+    for (group=0; group<NUM_GROUPS; group++) {
+        if (NV->groups[group].group_switch == sw) {
+            groupSwitchPressed(group);
+            return;
+        }
+    }
     // loop through all the sections to work out with which section the switch
     // is associated.
     section=switch2Section[sw];
@@ -208,21 +237,103 @@ void switch_pressed(unsigned char sw, unsigned char state) {
     }
 }
 
+/**
+ * A group switch has been pressed. Release the group if we already control all
+ * of it otherwise take it.
+ * @param group
+ */
+static void groupSwitchPressed(unsigned char group) {
+    SectionMask mask = 0;
+    unsigned char b;
+    
+    if ( ! sectionLookupValid) {
+        buildSectionLookup();
+    }
+    for (b=0; b<SECTION_MASK_BYTES; b++) {
+        mask = (mask << 8) | NV->groups[group].group_mask[b];
+    }
+    mask &= configuredSections;
+    if (mask == 0) return;
+    if ((ourControlled & mask) == mask) {
+        releaseGroupControl(mask);
+    } else {
+        requestGroupControl(mask);
+    }
+}
+
+/**
+ * Take control of a group of sections with one message per CAN4DC. Either all
+ * of the group is taken or none of it. Unless the panels use take sequence
+ * numbers an ASON3 is sent for each section as well, for the panels and other
+ * modules which only understand those.
+ * @param mask the sections in the group
+ */
+void requestGroupControl(SectionMask mask) {
+    unsigned char section;
+    SectionMask take;
+    SectionMask leftover;
+    
+    if ((otherControlled & mask) && ! (NV->flags & NV_FLAG_MASTER_PANEL)) {
+        // some of the group belongs to another panel
+        return;
+    }
+    take = mask & ~ourControlled;
+    leftover = sendSectionDigests(OWNERSHIP_TAKE, take);
+    for (section=0; take; section++, take >>= 1, leftover >>= 1) {
+        if (leftover & 1) {
+            requestControl(section);
+        } else if (take & 1) {
+            setSectionState(section, TRUE, FALSE);
+            if ( ! (NV->flags & NV_FLAG_TAKE_SEQUENCE)) {
+                sendControlEvent(section, TRUE);
+            }
+        }
+    }
+    ownershipChanged();
+}
+
+/**
+ * Release control of a group of sections with one message per CAN4DC, and an
+ * ASOF3 for each section unless the panels use take sequence numbers.
+ * @param mask the sections in the group
+ */
+void releaseGroupControl(SectionMask mask) {
+    unsigned char section;
+    SectionMask release;
+    SectionMask leftover;
+    
+    release = mask & ourControlled;
+    leftover = sendSectionDigests(OWNERSHIP_RELEASE, release);
+    for (section=0; release; section++, release >>= 1, leftover >>= 1) {
+        if (leftover & 1) {
+            releaseControl(section);
+        } else if (release & 1) {
+            setSectionState(section, FALSE, FALSE);
+            if (NV->flags & NV_FLAG_STOP_ON_RELEASE) {
+                setSpeed(section, 0);
+            }
+            if ( ! (NV->flags & NV_FLAG_TAKE_SEQUENCE)) {
+                sendControlEvent(section, FALSE);
+            }
+        }
+    }
+    ownershipChanged();
+}
+
 void requestControl(unsigned char section) {
     // Tell other panels we are taking control  
     unsigned char nnl = NV->sections[section].section_nn_bytes.section_nn_l;
     unsigned char nnh = NV->sections[section].section_nn_bytes.section_nn_h;
-    cbusMsg[d5] = nnh;
-    cbusMsg[d6] = nnl;
-    cbusMsg[d7] = NV->sections[section].section_en_bytes.section_en_l;
     if ((nnh == 0 ) && (nnl == 0)) return;
-    if (getProducedEvent(HAPPENING_SECTION_CONTROL)) {
-        // This should be a ASON3
-        cbusSendEventWithData( CBUS_OVER_CAN, 0, producedEvent.EN, 1, cbusMsg, 3);
+    if ((NV->flags & NV_FLAG_TAKE_SEQUENCE) || ackMode()) {
+        // An ACDAT take carries a sequence number to settle a tie with
+        // another panel, and is acknowledged with NV ack_attempts set
+        sendSectionDigests(OWNERSHIP_TAKE, SECTION_BIT(section));
     }
+    sendControlEvent(section, TRUE);
     
-    clearLed(sections[section].otherControlled_led);
-    setLed(sections[section].ourControl_led);
+    setSectionState(section, TRUE, FALSE);
+    ownershipChanged();
 }
 
 void releaseControl(unsigned char section) {
@@ -230,38 +341,85 @@ void releaseControl(unsigned char section) {
     unsigned char nnh = NV->sections[section].section_nn_bytes.section_nn_h;
     if ((nnh == 0 ) && (nnl == 0)) return;
     
-    clearLed(sections[section].otherControlled_led);
-    clearLed(sections[section].ourControl_led);
+    setSectionState(section, FALSE, FALSE);
+    ownershipChanged();
     if (NV->flags & NV_FLAG_STOP_ON_RELEASE) {
         setSpeed(section, 0);
     }
     // Tell other panels we have released control  
-    cbusMsg[d5] = nnh;
-    cbusMsg[d6] = nnl;
+    if ((NV->flags & NV_FLAG_TAKE_SEQUENCE) || ackMode()) {
+        sendSectionDigests(OWNERSHIP_RELEASE, SECTION_BIT(section));
+    }
+    sendControlEvent(section, FALSE);
+}
+
+/**
+ * Tell other panels we have taken or released a section.
+ * @param section
+ * @param on TRUE for a take (ASON3), FALSE for a release (ASOF3)
+ */
+static void sendControlEvent(unsigned char section, BOOL on) {
+    cbusMsg[d5] = NV->sections[section].section_nn_bytes.section_nn_h;
+    cbusMsg[d6] = NV->sections[section].section_nn_bytes.section_nn_l;
     cbusMsg[d7] = NV->sections[section].section_en_bytes.section_en_l;
     if (getProducedEvent(HAPPENING_SECTION_CONTROL)) {
-        // This should be a ASOF3
-        cbusSendEventWithData( CBUS_OVER_CAN, 0, producedEvent.EN, 0, cbusMsg, 3);
+        cbusSendEventWithData( CBUS_OVER_CAN, 0, producedEvent.EN, on, cbusMsg, 3);
     }
 }
 
 unsigned char isOurControlled(unsigned char section) {
-    return testLed(sections[section].ourControl_led);
+    return (ourControlled & SECTION_BIT(section)) != 0;
 }
 
 unsigned char isOtherControlled(unsigned char section) {
-    return testLed(sections[section].otherControlled_led    );
+    return (otherControlled & SECTION_BIT(section)) != 0;
 }
 
 
 void gotOtherControlledMessage(unsigned char section) {
     // we didn't send the message so another panel has control
-    setLed(sections[section].otherControlled_led);
-    clearLed(sections[section].ourControl_led);
+    renewLease(section);
+    if (otherControlled & SECTION_BIT(section)) return;    // just a heartbeat
+    setSectionState(section, FALSE, TRUE);
+    ownershipChanged();
 }
 void lostOtherControlledMessage(unsigned char section) {
-    clearLed(sections[section].otherControlled_led);
-    clearLed(sections[section].ourControl_led);
+    setSectionState(section, FALSE, FALSE);
+    ownershipChanged();
+}
+
+/**
+ * We no longer know whether another panel controls this section.
+ */
+void forgetOtherControl(unsigned char section) {
+    otherControlled &= ~SECTION_BIT(section);
+    if ( ! (ourControlled & SECTION_BIT(section))) {
+        forgetTakeSeq(section);
+    }
+    sectionLedsStale = TRUE;
+}
+
+/**
+ * Stop controlling a section without telling anyone, until we know whether 
+ * another panel has taken it.
+ */
+void forgetOurControl(unsigned char section) {
+    ourControlled &= ~SECTION_BIT(section);
+    if ( ! (otherControlled & SECTION_BIT(section))) {
+        forgetTakeSeq(section);
+    }
+    sectionLedsStale = TRUE;
+}
+
+/**
+ * Take back control of a section after power up without telling anyone. 
+ * @return TRUE if the section is configured and control was restored
+ */
+BOOL restoreOurControl(unsigned char section) {
+    if ((NV->sections[section].section_nn_bytes.section_nn_h == 0) && 
+            (NV->sections[section].section_nn_bytes.section_nn_l == 0)) return FALSE;
+    setSectionState(section, TRUE, FALSE);
+    return TRUE;
 }
 
 void receivedControlMessage(unsigned char * rx_ptr) {
@@ -272,15 +430,25 @@ void receivedControlMessage(unsigned char * rx_ptr) {
     unsigned char nnl = rx_ptr[d6];
     unsigned char enl = rx_ptr[d7];
     unsigned char enh = 0;
+    SectionMask configured;
     
-    // look for this section in the NVs
-    for (section = 0; section <NUM_SECTIONS; section++) {
+    if ( ! sectionLookupValid) {
+        buildSectionLookup();
+    }
+    // look for this section in the NVs, skipping those without a node number
+    configured = configuredSections;
+    for (section = 0; configured; section++, configured >>= 1) {
+        if ( ! (configured & 1)) continue;
         if (NV->sections[section].section_nn_bytes.section_nn_h != nnh) continue;
         if (NV->sections[section].section_nn_bytes.section_nn_l != nnl) continue;
         if (NV->sections[section].section_en_bytes.section_en_h != enh) continue;
         if (NV->sections[section].section_en_bytes.section_en_l != enl) continue;
         
         // It is for one of the sections we are managing
+        if ((NV->flags & NV_FLAG_TAKE_SEQUENCE) && (enl <= 15)) {
+            // the panel sent the change as an ACDAT too, which settles ties
+            continue;
+        }
         if (opc&1) {
             // OFF event
             lostOtherControlledMessage(section);
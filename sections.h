@@ -45,7 +45,9 @@ struct Section {
 };
 typedef struct Section Section;
 
-extern Section sections[NUM_SECTIONS];
+extern const rom Section sections[NUM_SECTIONS];
+extern SectionMask ourControlled;
+extern SectionMask otherControlled;
 
 extern void initSections(void);
 extern void switch_pressed(unsigned char sw, unsigned char state);
@@ -54,6 +56,17 @@ extern void releaseControl(unsigned char section);
 extern void receivedControlMessage(unsigned char * rx_ptr);
 extern unsigned char isOurControlled(unsigned char section);
 extern unsigned char isOtherControlled(unsigned char section);
+extern void invalidateSectionLookup(void);
+extern void forgetOurControl(unsigned char section);
+extern BOOL restoreOurControl(unsigned char section);
+extern void gotOtherControlledMessage(unsigned char section);
+extern void lostOtherControlledMessage(unsigned char section);
+extern void requestGroupControl(SectionMask mask);
+extern void releaseGroupControl(SectionMask mask);
+extern void forgetOtherControl(unsigned char section);
+extern void refreshSectionLeds(void);
+extern unsigned char countOurControlled(void);
+extern void releaseAllControl(void);
 
 #ifdef	__cplusplus
 }
@@ -37,22 +37,25 @@
 #include "candccab.h"
 #include "cbus.h"
 #include "sections.h"
+#include "switches.h"
+#include "board.h"
 
 
-// PIN configs
+// The IO pins are given by the board description header. On the CANPAN
 // RA0-RA2 are used to indicate which of the 8 rows is being scanned.
 // RB0-RB4 are the switch column bits.
+// Each matrix has 8 rows of 4 columns. Matrix m uses switch_matrix[8m to 8m+7].
 
 static unsigned char scan_column;
-unsigned char switch_matrix[8]; // lower 4 bits are used
+unsigned char switch_matrix[8 * NUM_MATRICES]; // lower 4 bits are used
 
 #define DEBOUNCE    8   // time to ignore changes after the first change
                         // Units of 8ms so that 8 = 64ms
-unsigned char debounce[8][4];
+unsigned char debounce[8 * NUM_MATRICES][4];
 
 void initSwitches(void) {
     unsigned char i;
-    for (i=0; i<8; i++) {
+    for (i=0; i<8 * NUM_MATRICES; i++) {
         switch_matrix[i] = 0;
         debounce[i][0] = 0;
         debounce[i][1] = 0;
@@ -60,13 +63,39 @@ void initSwitches(void) {
         debounce[i][3] = 0;
     }
     //Set up the IO ports to be able to read the switch matrix
-    TRISA = 0x28;  // RA0-RA2 are outputs RA3 is PB
-
-    TRISB = 0xf;    // upper 4 bits are outputs, lower 4 are inputs
+    BOARD_SWITCH_INIT();
     scan_column = 0;
-    LATA = scan_column;
+    BOARD_SELECT_SWITCH_ROW(scan_column);
 }
 
+/*
+ * The scan of one switch of the current row. Unrolled so the bit and switch 
+ * numbers are constants.
+ */
+#define SCAN_SWITCH(m, i) \
+    if (debounce[row][i] >0) { \
+        /* still in a debounce period */ \
+        debounce[row][i]--; \
+    } else if (diffs & (1<<(i))) { \
+        /* have a change after the debounce time since last change */ \
+        debounce[row][i] = DEBOUNCE; \
+        /* call the section state machine */ \
+        if (callback) switch_pressed((m)*32 + (i)*8 + scan_column, col & (1<<(i))); \
+    }
+
+/*
+ * The scan of the current row of matrix m.
+ */
+#define SCAN_MATRIX(m) \
+    row = (m)*8 + scan_column; \
+    col = BOARD_READ_SWITCH_COLUMNS_##m(); \
+    diffs = col^ switch_matrix[row]; \
+    switch_matrix[row] = col; \
+    SCAN_SWITCH(m, 0) \
+    SCAN_SWITCH(m, 1) \
+    SCAN_SWITCH(m, 2) \
+    SCAN_SWITCH(m, 3)
+
 /**
  * Check if a switch has been pressed. Also debounces the switch.
  * @param callback flag to indicate whether to call back into the section state machine. A function pointer would have been nice but unsupported by C18
@@ -74,35 +103,17 @@ void initSwitches(void) {
 void pollSwitches(unsigned char callback) {
     unsigned char col;
     unsigned char diffs;
-    unsigned char i;
-    // read the current column
-    col = (PORTB & 0xf);
-    // check if there are any changes
-    diffs = col^ switch_matrix[scan_column];
-    switch_matrix[scan_column] = col;
-    // go through each of the 4 col bits
-    for (i=0; i<4; i++) {
-        // check if we are still in a debounce period
-        if (debounce[scan_column][i] >0) {
-            debounce[scan_column][i]--;
-        } else {
-            // check if the bit has changed
-            unsigned char bit = (1<<i);
-            if (diffs & bit) {
-                // have a change after the debounce time since last change
-                
-                // set the debounce timer again
-                debounce[scan_column][i] = DEBOUNCE;
-                // call the section state machine
-                if (callback) switch_pressed(i*8 + scan_column, col & bit);
-            }
-        }
-    }
+    unsigned char row;
+    
+    SCAN_MATRIX(0)
+#if NUM_MATRICES > 1
+    SCAN_MATRIX(1)
+#endif
     
     // get ready for next row.
     scan_column++;
     scan_column &=0x7;
-    LATA = scan_column;
+    BOARD_SELECT_SWITCH_ROW(scan_column);
 }
 
 /**
@@ -111,5 +122,5 @@ void pollSwitches(unsigned char callback) {
  * @return switch state
  */
 unsigned char getSwitchState(unsigned char sw) {
-    return switch_matrix[sw & 7] & (1 << (sw/8));
-}
\ No newline at end of file
+    return switch_matrix[(sw/32)*8 + (sw & 7)] & (1 << ((sw/8) & 3));
+}
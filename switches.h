@@ -12,12 +12,14 @@
 extern "C" {
 #endif
 
-    #define NUM_SWITCHES 32
+#include "candccab.h"
+
+    #define NUM_SWITCHES (32 * NUM_MATRICES)
     extern void initSwitches(void);
     extern void pollSwitches(unsigned char callback);
     extern unsigned char getSwitchState(unsigned char sw);
     
-    extern unsigned char switch_matrix[8];
+    extern unsigned char switch_matrix[8 * NUM_MATRICES];
 
 #ifdef	__cplusplus
 }
@@ -0,0 +1,108 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   sync.c
+ * Author: Ian
+ * 
+ * Elect the panel which sends the sync so that only one of them does, see 
+ * sync.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "cabdcNv.h"
+#include "cbus.h"
+#include "can18.h"
+#include "sync.h"
+
+BYTE syncMaster;
+WORD syncFailovers;
+WORD syncFailoverTime;
+static TickValue lastHeardTime;        // sync from a lower CANID, or when we started listening
+static TickValue lastSyncTime;         // our own sync
+
+static DWORD syncPeriod(void) {
+    return (DWORD)NV->sync_tx * HUNDRED_MILI_SECOND;
+}
+
+/**
+ * Start listening for another master. Call at power up and again once CBUS 
+ * messages may be sent, so that we listen for a while before sending.
+ */
+void initSync(void) {
+    syncMaster = SYNC_NO_MASTER;
+    syncFailovers = 0;
+    syncFailoverTime = 0;
+    lastHeardTime.Val = tickGet();
+    lastSyncTime.Val = lastHeardTime.Val;
+}
+
+/**
+ * Another panel has sent a sync.
+ * @param msg the OPC_TON message
+ */
+void syncReceived(BYTE * msg) {
+    BYTE canId;
+    
+    canId = ((msg[sidh] << 3) | (msg[sidl] >> 5)) & 0x7F;
+    if (NV->sync_tx == 0) {
+        // not taking part so just note who is sending
+        syncMaster = canId;
+        return;
+    }
+    if (canId > canID) return;     // it will hear us and stop
+    // follow the lowest, or whoever has taken over from a master gone quiet
+    if ((canId <= syncMaster) || (tickTimeSince(lastHeardTime) > syncPeriod())) {
+        syncMaster = canId;
+        lastHeardTime.Val = tickGet();
+    }
+}
+
+/**
+ * Call regularly once CBUS messages may be sent. Sends our sync if we are the 
+ * master or takes over if the master has gone quiet.
+ */
+void pollSync(void) {
+    DWORD period;
+    DWORD silence;
+    
+    if (NV->sync_tx == 0) return;
+    period = syncPeriod();
+    if (syncMaster != canID) {
+        silence = tickTimeSince(lastHeardTime);
+        if (silence <= period + period/2 + (DWORD)canID * SYNC_STAGGER) return;
+        if (syncMaster != SYNC_NO_MASTER) {
+            syncFailovers++;
+            syncFailoverTime = (WORD)(silence / ONE_MILI_SECOND);
+        }
+        syncMaster = canID;
+        lastSyncTime.Val = tickGet() - period - 1;     // send straight away
+    }
+    if (tickTimeSince(lastSyncTime) > period) {
+        cbusMsg[d0] = OPC_TON;
+        cbusSendMsg(ALL_CBUS, cbusMsg);     // send a sync 
+        lastSyncTime.Val = tickGet();
+    }
+}
@@ -0,0 +1,68 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   sync.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef SYNC_H
+#define	SYNC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "TickTime.h"
+
+/*
+ * Only one panel sends the OPC_TON sync every NV sync_tx x 100ms. OPC_TON has
+ * no data so the panels are told apart by the CANID of the frame. Of the 
+ * panels with sync_tx set, the one with the lowest CANID is the master. A 
+ * panel stays silent while it hears a lower CANID sending sync and takes over 
+ * if that has not been heard for one and a half periods, plus SYNC_STAGGER 
+ * for each step of its CANID so that the lowest remaining panel goes first and
+ * the others hear it before their own time is up. A panel which
+ * hears no lower CANID for that long starts sending itself, as it does after
+ * power up, and a higher master then goes quiet when it hears it.
+ * sync_tx should be the same on all the panels that have it set.
+ */
+#define SYNC_STAGGER            (2*ONE_MILI_SECOND)
+#define SYNC_NO_MASTER          0xFF
+
+extern void initSync(void);
+extern void pollSync(void);
+extern void syncReceived(BYTE * msg);
+
+extern BYTE syncMaster;                 // CANID of the master, our own when it is us
+extern WORD syncFailovers;
+extern WORD syncFailoverTime;           // ms from the last sync of the old master to our first
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SYNC_H */
+
@@ -24,7 +24,8 @@
  * File:   tests.c
  * Author: Ian
  * 
- * Test a CANPAN LED/switch matrix.
+ * Test a CANPAN LED/switch matrix, the potentiometer and the CAN path.
+ * Measure the potentiometer's noise to set the pot NVs.
  *
  * Created on 26 Mar 2020
  */
@@ -35,7 +36,18 @@
 #include "switches.h"
 #include "leds.h"
 #include "analogue.h"
-#include "statusLeds.h"
+#include "StatusLeds.h"
+#include "module.h"
+#include "cbus.h"
+#include "can18.h"
+#include "cabdccan18.h"
+#include "cabdcEEPROM.h"
+#include "latency.h"
+#include "cabdcNv.h"
+#include "tests.h"
+#ifdef NV_CACHE
+#include "nvCache.h"
+#endif
 
 extern TickValue startTime;
 extern TickValue lastSwitchPollTime;
@@ -72,15 +84,15 @@ void test1(void) {
 
         if (testStep >= TEST_SWITCHES) {    
             // just copy switches to leds
-            for (i=0; i<4; i++) {
+            for (i=0; i<4 * NUM_MATRICES; i++) {
                 led_matrix[i] = (switch_matrix[2*i] & 0xF) | (switch_matrix[2*i+1]<<4);
             }
         } 
         if (tickTimeSince(testTime) > (ONE_SECOND)) {
             if ((testStep >= TEST_COL1) && (testStep <= TEST_COL4)) {
                 // illuminate the cols in turn
-                for (i=0; i<4; i++) {
-                    if (i == (testStep-TEST_COL1)) {
+                for (i=0; i<4 * NUM_MATRICES; i++) {
+                    if ((i & 3) == (testStep-TEST_COL1)) {
                         led_matrix[i] = 0xff;
                     } else {
                         led_matrix[i] = 0;
@@ -90,7 +102,7 @@ void test1(void) {
             } 
             if ((testStep >= TEST_ROW1) && (testStep <= TEST_ROW8)) {
                 // illuminate the rows in turn
-                for (i=0; i<4; i++) {
+                for (i=0; i<4 * NUM_MATRICES; i++) {
                     led_matrix[i] = (1 << (testStep - TEST_ROW1));
                 }
             }
@@ -116,7 +128,7 @@ void test1(void) {
  * This test goes through a sequence of lighting each LED in turn. 
  */
 void test2(void) {
-    unsigned char led = 31;
+    unsigned char led = NUM_LEDS-1;
     TickValue testTime;
     testTime.Val = startTime.Val;
         
@@ -124,7 +136,7 @@ void test2(void) {
         if (tickTimeSince(testTime) > (ONE_SECOND)) {
             clearLed(led);
             led++;
-            if (led >=32) led=0;
+            if (led >= NUM_LEDS) led=0;
             setLed(led);
             testTime.Val = tickGet();
         }
@@ -165,3 +177,348 @@ void test3(void) {
     }
 }
 
+/*
+ * CAN loopback test. The ECAN is put in loopback mode and frames are sent with
+ * canTX() and read back with canbusRecv() through the transmit fifo, the
+ * interrupt routine and the receive fifo, just as in normal running. Each run
+ * first sends TEST4_LATENCY_FRAMES frames one at a time to time a frame through
+ * the driver and back, then keeps the transmit fifo full for TEST4_BLAST_TIME
+ * to find the sustained frame rate and the fifo high water marks. Each frame
+ * carries a sequence number so lost or misordered frames are counted.
+ *
+ * The results are shown on the first matrix as bars up each column:
+ *   column 1: frames per second, an LED per TEST4_RATE_STEP
+ *   column 2: average latency of a lone frame, an LED per TEST4_LATENCY_STEP
+ *   column 3: transmit fifo high water mark, in eighths of the fifo
+ *   column 4: receive fifo high water mark, in eighths of the fifo
+ * Column 1 flashes if any frames were lost. The first results are saved to
+ * EEPROM, see tests.h.
+ */
+#define TEST4_LATENCY_FRAMES    64
+#define TEST4_BLAST_TIME        ONE_SECOND
+#define TEST4_RX_TIMEOUT        (10 * ONE_MILI_SECOND)
+#define TEST4_DRAIN_TIME        (100 * ONE_MILI_SECOND)
+#define TEST4_RATE_STEP         128     // frames per second, so 8 LEDs is about the most 125kbit/s allows
+#define TEST4_LATENCY_STEP      128     // CAN timestamp ticks, 256us
+#define TEST4_FLASH_TIME        (HUNDRED_MILI_SECOND * 5)
+
+extern BYTE txIndexNextFree;
+extern BYTE maxCanTxFifo;
+extern BYTE maxCanRxFifo;
+extern BYTE rxOflowCount;
+
+static WORD loopbackResults[LOOPBACK_RESULTS];
+static WORD txSequence;
+static WORD rxSequence;
+
+// An LED bar of n LEDs up a column
+static unsigned char bar(WORD n) {
+    return (n >= 8) ? 0xFF : (1 << n) - 1;
+}
+
+static void test4Service(void) {
+    if (tickTimeSince(lastLedPollTime) > (2 * ONE_MILI_SECOND)) {
+        pollLeds();
+        lastLedPollTime.Val = tickGet();
+    }
+    checkFlashing();
+}
+
+static BOOL test4Send(void) {
+    CanPacket packet;
+    WORD now;
+
+    now = canTimestampNow();
+    packet.buffer[dlc] = 8;
+    packet.buffer[d0] = OPC_ACON3;
+    packet.buffer[d1] = 0;              // no node number so nothing would act on it
+    packet.buffer[d2] = 0;
+    packet.buffer[d3] = txSequence >> 8;
+    packet.buffer[d4] = txSequence & 0xFF;
+    packet.buffer[d5] = now >> 8;
+    packet.buffer[d6] = now & 0xFF;
+    packet.buffer[d7] = 0;
+    if ( ! canTX(&packet)) return FALSE;
+    txSequence++;
+    return TRUE;
+}
+
+// Receive a frame, checking its sequence number
+static BOOL test4Receive(CanPacket * packet) {
+    WORD sequence;
+
+    if ( ! canbusRecv(packet)) return FALSE;
+    sequence = ((WORD)packet->buffer[d3] << 8) | packet->buffer[d4];
+    if (sequence != rxSequence) {
+        loopbackResults[LOOPBACK_LOST]++;
+    }
+    rxSequence = sequence + 1;
+    return TRUE;
+}
+
+static void test4Latency(void) {
+    LatencyStats latency;
+    CanPacket packet;
+    TickValue sentTime;
+    WORD sent;
+    unsigned char n;
+
+    latencyClear(&latency);
+    for (n=0; n<TEST4_LATENCY_FRAMES; n++) {
+        test4Send();
+        sentTime.Val = tickGet();
+        while (tickTimeSince(sentTime) < TEST4_RX_TIMEOUT) {
+            if (test4Receive(&packet)) {
+                sent = ((WORD)packet.buffer[d5] << 8) | packet.buffer[d6];
+                latencyRecord(&latency, canTimestampNow() - sent);
+                break;
+            }
+            test4Service();
+        }
+    }
+    loopbackResults[LOOPBACK_LATENCY_MIN] = (latency.count == 0) ? 0 : latency.min;
+    loopbackResults[LOOPBACK_LATENCY_MAX] = latency.max;
+    loopbackResults[LOOPBACK_LATENCY_AVG] = latencyAverage(&latency);
+}
+
+static void test4Throughput(void) {
+    CanPacket packet;
+    TickValue startTime;
+    DWORD received = 0;
+    DWORD elapsed;
+
+    maxCanTxFifo = 0;
+    maxCanRxFifo = 0;
+    rxOflowCount = 0;
+    startTime.Val = tickGet();
+    while ((elapsed = tickTimeSince(startTime)) < TEST4_BLAST_TIME) {
+        while ((txIndexNextFree != 0xFF) && test4Send());
+        while (test4Receive(&packet)) {
+            received++;
+        }
+        test4Service();
+    }
+    loopbackResults[LOOPBACK_RATE] = (WORD)((received * ONE_SECOND) / elapsed);
+    // collect the frames still queued
+    startTime.Val = tickGet();
+    while ((rxSequence != txSequence) && (tickTimeSince(startTime) < TEST4_DRAIN_TIME)) {
+        test4Receive(&packet);
+        test4Service();
+    }
+    loopbackResults[LOOPBACK_LOST] += (txSequence - rxSequence) + rxOflowCount;
+    rxSequence = txSequence;
+    loopbackResults[LOOPBACK_FIFO_MAX] = ((WORD)maxCanTxFifo << 8) | maxCanRxFifo;
+}
+
+static void test4Show(BOOL flashOn) {
+    WORD fifo = loopbackResults[LOOPBACK_FIFO_MAX];
+
+    led_matrix[0] = (flashOn || (loopbackResults[LOOPBACK_LOST] == 0)) 
+            ? bar(loopbackResults[LOOPBACK_RATE] / TEST4_RATE_STEP) : 0;
+    led_matrix[1] = bar((loopbackResults[LOOPBACK_LATENCY_AVG] + TEST4_LATENCY_STEP - 1) / TEST4_LATENCY_STEP);
+    led_matrix[2] = bar(((fifo >> 8) * 8 + CANTX_FIFO_LEN - 1) / CANTX_FIFO_LEN);
+    led_matrix[3] = bar(((fifo & 0xFF) * 8 + CANRX_FIFO_LEN - 1) / CANRX_FIFO_LEN);
+}
+
+/**
+ * This test loops CAN frames back through the driver and shows the frame rate,
+ * latency and fifo use. The CAN driver must have been initialised.
+ */
+void test4(void) {
+    TickValue showTime;
+    TickValue flashTime;
+    BOOL flashOn = TRUE;
+    BOOL saved = FALSE;
+    unsigned char i;
+
+    canLoopback(TRUE);
+    txSequence = 0;
+    rxSequence = 0;
+    flashTime.Val = tickGet();
+
+    while (TRUE) {
+        loopbackResults[LOOPBACK_LOST] = 0;
+        test4Latency();
+        test4Throughput();
+        if ( ! saved) {
+            for (i=0; i<LOOPBACK_RESULTS; i++) {
+                ee_write_short(EE_LOOPBACK_RESULTS + 2*i, loopbackResults[i]);
+            }
+            saved = TRUE;
+        }
+        // show the results for a while before the next run
+        showTime.Val = tickGet();
+        while (tickTimeSince(showTime) < 4 * TEST4_FLASH_TIME) {
+            test4Show(flashOn);
+            if (tickTimeSince(flashTime) > TEST4_FLASH_TIME) {
+                flashOn = ! flashOn;
+                flashTime.Val = tickGet();
+            }
+            test4Service();
+        }
+    }
+}
+
+/*
+ * Potentiometer noise test. Leave the pot at the centre, off, position for the
+ * first TEST5_REST_SAMPLES readings, taken every TEST5_SAMPLE_TIME. Their peak
+ * to peak, variance and histogram give the noise at rest and the distance of
+ * their average from the centre is how far off centre the pot stops. From 
+ * these pot_dead_zone is set to just cover the noise and the offset, and 
+ * pot_hysteresis to the peak to peak so noise alone does not send speeds. 
+ * Afterwards sweep the pot slowly end to end. The noise on top of the 
+ * movement is measured over windows of TEST5_WINDOW readings, the range of 
+ * the window less its net movement, and pot_hysteresis is raised if this is
+ * bigger. The NVs are only written when they change.
+ *
+ * The first matrix shows:
+ *   column 1: peak to peak at rest, one LED and an LED per step, once measured
+ *   column 2: peak to peak in the sweep, an LED per step
+ *   column 3: the histogram at rest, an LED for each step from 4 below to 3
+ *             above the average lit if more than 1/32 of readings fell there
+ *   column 4: where the pot is now relative to the average at rest, the same
+ *             scale as column 3
+ * The results are kept in EEPROM, see tests.h.
+ */
+#define TEST5_SAMPLE_TIME       ONE_MILI_SECOND
+#define TEST5_REST_SAMPLES      2048
+#define TEST5_REST_SHIFT        11      // log2 TEST5_REST_SAMPLES
+#define TEST5_HISTOGRAM_LEN     16      // steps from 8 below the first reading to 7 above
+#define TEST5_WINDOW            8
+#define TEST5_MARGIN            1       // added to the dead zone
+
+static WORD noiseResults[NOISE_RESULTS];
+static WORD histogram[TEST5_HISTOGRAM_LEN];
+static unsigned char window[TEST5_WINDOW];
+
+// Change an NV the way an NVSET would
+static void test5SetNv(unsigned char index, unsigned char value) {
+    unsigned char oldValue;
+
+    oldValue = (unsigned char)readNodeVar(index);
+    if ((oldValue == value) || ! validateNV(index, oldValue, value)) return;
+    writeNodeVar(index, value);
+    actUponNVchange(index, oldValue, value);
+#ifdef NV_CACHE
+    flushNvCache();
+#endif
+}
+
+static void test5Save(void) {
+    unsigned char i;
+
+    for (i=0; i<NOISE_RESULTS; i++) {
+        ee_write_short(EE_NOISE_RESULTS + 2*i, noiseResults[i]);
+    }
+}
+
+static void test5Show(unsigned char first, BOOL rested) {
+    int mean;
+    int bin;
+    unsigned char i;
+
+    led_matrix[0] = rested ? bar(noiseResults[NOISE_REST_PEAK] + 1) : 0;
+    led_matrix[1] = bar(noiseResults[NOISE_SWEEP_PEAK]);
+    if ( ! rested) return;
+    mean = (noiseResults[NOISE_REST_MEAN] + 8) >> 4;
+    led_matrix[2] = 0;
+    for (i=0; i<8; i++) {
+        // bin of the reading mean-4+i
+        bin = mean - 4 + i - first + TEST5_HISTOGRAM_LEN/2;
+        if ((bin >= 0) && (bin < TEST5_HISTOGRAM_LEN) 
+                && (histogram[bin] > (TEST5_REST_SAMPLES >> 5))) {
+            led_matrix[2] |= 1 << i;
+        }
+    }
+    bin = (int)lastReading - mean + 4;
+    led_matrix[3] = 1 << ((bin < 0) ? 0 : (bin > 7) ? 7 : bin);
+}
+
+/**
+ * This test measures the noise on the potentiometer readings and sets the
+ * dead zone and hysteresis NVs to suit.
+ */
+void test5(void) {
+    TickValue sampleTime;
+    unsigned char first = 0;
+    unsigned char min = 255;
+    unsigned char max = 0;
+    unsigned char wMin;
+    unsigned char wMax;
+    unsigned char moved;
+    unsigned char i;
+    int d;
+    long sum = 0;
+    DWORD sumSquares = 0;
+    long meanX16;
+    WORD n = 0;
+    unsigned char offCentre;
+
+    for (i=0; i<TEST5_HISTOGRAM_LEN; i++) {
+        histogram[i] = 0;
+    }
+    for (i=0; i<NOISE_RESULTS; i++) {
+        noiseResults[i] = 0;
+    }
+    sampleTime.Val = tickGet();
+
+    while (TRUE) {
+        if (tickTimeSince(sampleTime) > TEST5_SAMPLE_TIME) {
+            sampleTime.Val = tickGet();
+            pollAnalogue(ANALOGUE_PORT);
+            if (n < TEST5_REST_SAMPLES) {
+                if (n == 0) first = lastReading;
+                if (lastReading < min) min = lastReading;
+                if (lastReading > max) max = lastReading;
+                d = (int)lastReading - first;
+                sum += d;
+                sumSquares += (long)d * d;
+                d += TEST5_HISTOGRAM_LEN/2;
+                histogram[(d < 0) ? 0 : (d >= TEST5_HISTOGRAM_LEN) ? TEST5_HISTOGRAM_LEN-1 : d]++;
+                if (++n == TEST5_REST_SAMPLES) {
+                    meanX16 = (sum << 4) >> TEST5_REST_SHIFT;
+                    noiseResults[NOISE_REST_PEAK] = max - min;
+                    noiseResults[NOISE_REST_VARIANCE] = (WORD)(((sumSquares << 4) >> TEST5_REST_SHIFT) 
+                            - ((meanX16 * meanX16) >> 4));
+                    noiseResults[NOISE_REST_MEAN] = (WORD)(((long)first << 4) + meanX16);
+                    // the dead zone covers where the pot stops and the noise either side
+                    d = (int)((noiseResults[NOISE_REST_MEAN] + 8) >> 4) - 128;
+                    offCentre = (d < 0) ? -d : d;
+                    test5SetNv(NV_POT_DEAD_ZONE, offCentre + (noiseResults[NOISE_REST_PEAK] + 1)/2 + TEST5_MARGIN);
+                    test5SetNv(NV_POT_HYSTERESIS, noiseResults[NOISE_REST_PEAK]);
+                    test5Save();
+                }
+            } else {
+                // the sweep
+                for (i=0; i<TEST5_WINDOW-1; i++) {
+                    window[i] = window[i+1];
+                }
+                window[TEST5_WINDOW-1] = lastReading;
+                if (++n >= TEST5_REST_SAMPLES + TEST5_WINDOW) {
+                    n = TEST5_REST_SAMPLES + TEST5_WINDOW;
+                    wMin = 255;
+                    wMax = 0;
+                    for (i=0; i<TEST5_WINDOW; i++) {
+                        if (window[i] < wMin) wMin = window[i];
+                        if (window[i] > wMax) wMax = window[i];
+                    }
+                    moved = (window[0] > window[TEST5_WINDOW-1]) ? window[0] - window[TEST5_WINDOW-1] 
+                            : window[TEST5_WINDOW-1] - window[0];
+                    if ((wMax - wMin - moved) > noiseResults[NOISE_SWEEP_PEAK]) {
+                        noiseResults[NOISE_SWEEP_PEAK] = wMax - wMin - moved;
+                        if (noiseResults[NOISE_SWEEP_PEAK] > noiseResults[NOISE_REST_PEAK]) {
+                            test5SetNv(NV_POT_HYSTERESIS, noiseResults[NOISE_SWEEP_PEAK]);
+                        }
+                        test5Save();
+                    }
+                }
+            }
+            test5Show(first, n >= TEST5_REST_SAMPLES);
+        }
+        if (tickTimeSince(lastLedPollTime) > (2 * ONE_MILI_SECOND)) {
+            pollLeds();
+            lastLedPollTime.Val = tickGet();
+        }
+        checkFlashing();
+    }
+}
@@ -15,12 +15,36 @@ extern "C" {
 extern void test1(void);
 extern void test2(void);
 extern void test3(void);
+extern void test4(void);
+extern void test5(void);
 
-#define NUM_TESTS 3
+#define NUM_TESTS 5
+
+/*
+ * Results of the CAN loopback test, test4. The first results after power up 
+ * are kept in EEPROM from EE_LOOPBACK_RESULTS, a word each, and can be read
+ * in normal mode as diagnostics DIAG_LOOPBACK_RATE onwards.
+ */
+#define LOOPBACK_RATE           0   // frames per second with the transmit fifo kept full
+#define LOOPBACK_LATENCY_MIN    1   // canTX() to canbusRecv() of a lone frame, CAN timestamp ticks
+#define LOOPBACK_LATENCY_MAX    2
+#define LOOPBACK_LATENCY_AVG    3
+#define LOOPBACK_FIFO_MAX       4   // transmit fifo high water mark << 8 | receive fifo high water mark
+#define LOOPBACK_LOST           5   // frames not received back or received out of order
+#define LOOPBACK_RESULTS        6
+
+/*
+ * Results of the potentiometer noise test, test5, kept in EEPROM from 
+ * EE_NOISE_RESULTS and read as diagnostics DIAG_NOISE_REST_PEAK onwards.
+ */
+#define NOISE_REST_PEAK         0   // peak to peak of the readings with the pot at rest
+#define NOISE_REST_VARIANCE     1   // variance of the readings at rest, 1/16ths of a step squared
+#define NOISE_REST_MEAN         2   // average reading at rest, 1/16ths of a step
+#define NOISE_SWEEP_PEAK        3   // peak to peak of the noise on top of the movement in a sweep
+#define NOISE_RESULTS           4
 
 #ifdef	__cplusplus
 }
 #endif
 
 #endif	/* TESTS_H */
-
@@ -0,0 +1,153 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   trace.c
+ * Author: Ian
+ * 
+ * Record received frames and switch changes in a RAM ring. See trace.h.
+ *
+ * Created on 19 October 2026
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "cbus.h"
+#include "can18.h"
+#include "trace.h"
+
+#ifdef FRAME_TRACE
+
+typedef struct {
+    TickValue time;
+    BYTE source;
+    BYTE len;
+    BYTE d[8];
+} TraceEntry;
+
+#pragma udata TRACE_BUFFER
+static TraceEntry trace[TRACE_LEN];
+#pragma udata
+
+static BYTE traceNext;          // where the next entry goes
+static BYTE traceCount;         // entries recorded, up to TRACE_LEN
+static BOOL traceHeld;          // not recording while the trace is read
+static TickValue traceHeldTime;
+
+void initTrace(void) {
+    traceNext = 0;
+    traceCount = 0;
+    traceHeld = FALSE;
+}
+
+static TraceEntry * traceAdd(void) {
+    TraceEntry * e;
+
+    e = &trace[traceNext];
+    e->time.Val = tickGet();
+    if (++traceNext >= TRACE_LEN) traceNext = 0;
+    if (traceCount < TRACE_LEN) traceCount++;
+    return e;
+}
+
+/**
+ * Record a frame the firmware is about to handle.
+ * @param msg the frame as returned by cbusMsgReceived()
+ */
+void traceFrame(BYTE * msg) {
+    TraceEntry * e;
+    BYTE i;
+
+    if (traceHeld) return;
+    e = traceAdd();
+    e->source = ((msg[sidh] << 3) | (msg[sidl] >> 5)) & 0x7F;
+    e->len = msg[dlc] & 0x0F;
+    // bytes past the end of the frame are whatever the buffer last held
+    for (i=0; i<8; i++) {
+        e->d[i] = (i < e->len) ? msg[d0+i] : 0;
+    }
+}
+
+/**
+ * Record a switch change passed to switch_pressed().
+ */
+void traceSwitch(BYTE sw, BYTE state) {
+    TraceEntry * e;
+    BYTE i;
+
+    if (traceHeld) return;
+    e = traceAdd();
+    e->source = state ? (TRACE_SWITCH | 1) : TRACE_SWITCH;
+    e->len = sw;
+    for (i=0; i<8; i++) {
+        e->d[i] = 0;
+    }
+}
+
+/**
+ * Copy entries out for a BULK_TRACE_DATA message. Reading entry 0 holds the
+ * trace and reading the newest lets it carry on.
+ * @param first the first entry wanted, 0 for the oldest
+ * @param max the most entries there is room for
+ * @param dest where to put them
+ * @return the number of entries copied
+ */
+BYTE traceRead(BYTE first, BYTE max, BYTE * dest) {
+    TraceEntry * e;
+    BYTE index;
+    BYTE n;
+    BYTE i;
+
+    if (first == 0) {
+        traceHeld = TRUE;
+    }
+    traceHeldTime.Val = tickGet();
+    for (n=0; (n < max) && (first + n < traceCount); n++) {
+        index = traceNext + TRACE_LEN - traceCount + first + n;
+        if (index >= TRACE_LEN) index -= TRACE_LEN;
+        e = &trace[index];
+        *dest++ = (BYTE)(e->time.Val >> 24);
+        *dest++ = (BYTE)(e->time.Val >> 16);
+        *dest++ = (BYTE)(e->time.Val >> 8);
+        *dest++ = (BYTE)e->time.Val;
+        *dest++ = e->source;
+        *dest++ = e->len;
+        for (i=0; i<8; i++) {
+            *dest++ = e->d[i];
+        }
+    }
+    if (first + n >= traceCount) {
+        traceHeld = FALSE;
+    }
+    return n;
+}
+
+/**
+ * Call regularly to start recording again if a read was abandoned.
+ */
+void pollTrace(void) {
+    if (traceHeld && (tickTimeSince(traceHeldTime) > TRACE_HOLD_TIME)) {
+        traceHeld = FALSE;
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+*/ 
+/* 
+ * File:   trace.h
+ * Author: Ian
+ *
+ * Created on 19 October 2026
+ */
+
+#ifndef TRACE_H
+#define	TRACE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "TickTime.h"
+
+/*
+ * A record of the last TRACE_LEN frames received and switch changes, so that
+ * what happened on the layout can be read back over CBUS and replayed by the 
+ * host build. See "Frame trace" in the README.
+ * 
+ * The trace is read with a bulk transfer (see bulkNv.h) request to stream
+ * BULK_NV_STREAM_ID:
+ *   BULK_TRACE_READ <NN hi> <NN lo> <first> <count>
+ * which is answered on the stream numbered with our CANID with:
+ *   BULK_TRACE_DATA <NN hi> <NN lo> <first> <count> [<entries>...]
+ * Entry 0 is the oldest. As many entries as fit are sent, count is the number
+ * actually sent and is 0 once first is past the newest. Recording stops when 
+ * entry 0 is read so that the entries don't move while the trace is read in 
+ * several parts, and starts again when the newest has been sent or after 
+ * TRACE_HOLD_TIME.
+ * 
+ * Each entry is TRACE_ENTRY_LEN bytes:
+ *   <tick 31-24> <tick 23-16> <tick 15-8> <tick 7-0> <source> <len> <d0>...<d7>
+ * where tick is tickGet() when it was handled. For a frame source is the 
+ * sender's CANID and len the number of data bytes. For a switch change source
+ * is TRACE_SWITCH, or TRACE_SWITCH|1 if it is now on, and len the switch number.
+ */
+#define TRACE_LEN           16
+#define TRACE_ENTRY_LEN     14
+#define TRACE_SWITCH        0x80
+#define TRACE_HOLD_TIME     (5*ONE_SECOND)
+
+extern void initTrace(void);
+extern void traceFrame(BYTE * msg);
+extern void traceSwitch(BYTE sw, BYTE state);
+extern BYTE traceRead(BYTE first, BYTE max, BYTE * dest);
+extern void pollTrace(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TRACE_H */